@@ -0,0 +1,270 @@
+#include <string.h>
+#include <errno.h>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#include "binary_log.h"
+
+template<class T>
+static void append_pod(const T & val, std::string * out)
+{
+    out->append(reinterpret_cast<const char *>(&val), sizeof(T));
+}
+
+static bool fits_i32(int64_t val)
+{
+    return val >= std::numeric_limits<int32_t>::min() && val <= std::numeric_limits<int32_t>::max();
+}
+
+static int64_t to_ms(double elapsed_s)
+{
+    return int64_t(std::llround(elapsed_s * 1000.0));
+}
+
+Binary_Log_Schema::Binary_Log_Schema() : flags(0), columns(), radios(), wall_time(0), elapsed_ms(0)
+{}
+
+uint32_t Binary_Log_Schema::values_size() const
+{
+    uint32_t tx_size = 0;
+    for (uint8_t col = 0; col < columns.tx_column_count; ++col)
+        tx_size += blog::value_size(columns.tx_columns[col]);
+
+    uint32_t rx_size = 0;
+    for (uint8_t col = 0; col < columns.rx_column_count; ++col)
+        rx_size += blog::value_size(columns.rx_columns[col]);
+
+    uint32_t size = 0;
+    for (size_t i = 0; i < radios.size(); ++i)
+    {
+        if (strchr(radios[i].serial, 'T'))
+            size += tx_size;
+        else if (strchr(radios[i].serial, 'R'))
+            size += rx_size;
+    }
+    return size;
+}
+
+namespace blog
+{
+uint8_t value_size(uint8_t param)
+{
+    if (log_param_is_status(param))
+        return sizeof(uint8_t);
+    return sizeof(float);
+}
+
+void append_schema(Binary_Log_Schema * schema, time_t wall_time, double elapsed_s, std::string * out)
+{
+    schema->wall_time = wall_time;
+    schema->elapsed_ms = to_ms(elapsed_s);
+
+    out->push_back(BLOG_SCHEMA_TAG);
+    out->append(BLOG_MAGIC, 4);
+    out->push_back(BLOG_VERSION);
+    out->push_back(schema->flags);
+    append_pod(schema->wall_time, out);
+    append_pod(schema->elapsed_ms, out);
+
+    const Log_Columns & cols = schema->columns;
+    out->push_back(cols.tx_column_count);
+    out->append(reinterpret_cast<const char *>(cols.tx_columns), cols.tx_column_count);
+    out->push_back(cols.rx_column_count);
+    out->append(reinterpret_cast<const char *>(cols.rx_columns), cols.rx_column_count);
+    for (uint8_t i = 0; i < LP_COUNT; ++i)
+    {
+        uint8_t len = uint8_t(std::min(cols.titles[i].size(), size_t(255)));
+        out->push_back(len);
+        out->append(cols.titles[i], 0, len);
+    }
+
+    uint32_t radio_count = schema->radios.size();
+    append_pod(radio_count, out);
+    for (uint32_t i = 0; i < radio_count; ++i)
+    {
+        out->append(schema->radios[i].serial, BLOG_SERIAL_SIZE);
+        append_pod(schema->radios[i].freq_mhz, out);
+    }
+}
+
+bool append_record_start(Binary_Log_Schema * schema, time_t wall_time, double elapsed_s, std::string * out)
+{
+    int64_t elapsed_ms = to_ms(elapsed_s);
+    int64_t wall_delta = int64_t(wall_time) - schema->wall_time;
+    int64_t elapsed_delta = elapsed_ms - schema->elapsed_ms;
+    if (!fits_i32(wall_delta) || !fits_i32(elapsed_delta))
+        return false;
+
+    out->push_back(BLOG_RECORD_TAG);
+    append_pod(int32_t(wall_delta), out);
+    append_pod(int32_t(elapsed_delta), out);
+    schema->wall_time = wall_time;
+    schema->elapsed_ms = elapsed_ms;
+    return true;
+}
+
+void append_value(uint8_t param, float value, std::string * out)
+{
+    if (log_param_is_status(param))
+        out->push_back(char(uint8_t(value)));
+    else
+        append_pod(value, out);
+}
+
+float read_value(uint8_t param, const uint8_t * data)
+{
+    if (log_param_is_status(param))
+        return data[0];
+    float ret;
+    memcpy(&ret, data, sizeof(float));
+    return ret;
+}
+} // namespace blog
+
+Binary_Log_Reader::Binary_Log_Reader() : m_file(nullptr), m_schema(), m_have_schema(false), m_values(), m_error()
+{}
+
+Binary_Log_Reader::~Binary_Log_Reader()
+{
+    close();
+}
+
+bool Binary_Log_Reader::open(const std::string & fname)
+{
+    close();
+    m_file = fopen(fname.c_str(), "rb");
+    if (!m_file)
+    {
+        m_error = "could not open " + fname + ": " + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+void Binary_Log_Reader::close()
+{
+    if (m_file)
+        fclose(m_file);
+    m_file = nullptr;
+    m_have_schema = false;
+    m_error.clear();
+}
+
+Binary_Log_Reader::Block Binary_Log_Reader::next()
+{
+    if (!m_file)
+        return _fail("no file open");
+
+    int tag = fgetc(m_file);
+    if (tag == EOF)
+        return End;
+    if (tag == BLOG_SCHEMA_TAG)
+        return _read_schema();
+    if (tag == BLOG_RECORD_TAG)
+        return _read_record();
+    return _fail("unknown block tag " + std::to_string(tag) + " at offset " + std::to_string(ftell(m_file) - 1));
+}
+
+Binary_Log_Reader::Block Binary_Log_Reader::_read_schema()
+{
+    Binary_Log_Schema schema;
+    char magic[4];
+    uint8_t version = 0;
+    if (!_read(magic, 4) || !_read(&version, 1))
+        return _fail("truncated schema");
+    if (memcmp(magic, BLOG_MAGIC, 4) != 0)
+        return _fail("bad schema magic - not a radio log or written with a different byte order");
+    if (version != BLOG_VERSION)
+        return _fail("unsupported version " + std::to_string(version));
+
+    if (!_read(&schema.flags, 1) || !_read(&schema.wall_time, sizeof(int64_t)) || !_read(&schema.elapsed_ms, sizeof(int64_t)))
+        return _fail("truncated schema");
+
+    Log_Columns & cols = schema.columns;
+    if (!_read(&cols.tx_column_count, 1) || cols.tx_column_count > LP_COUNT || !_read(cols.tx_columns, cols.tx_column_count) ||
+        !_read(&cols.rx_column_count, 1) || cols.rx_column_count > LP_COUNT || !_read(cols.rx_columns, cols.rx_column_count))
+        return _fail("bad schema columns");
+    for (uint8_t col = 0; col < cols.tx_column_count; ++col)
+        if (cols.tx_columns[col] >= LP_COUNT)
+            return _fail("bad schema columns");
+    for (uint8_t col = 0; col < cols.rx_column_count; ++col)
+        if (cols.rx_columns[col] >= LP_COUNT)
+            return _fail("bad schema columns");
+
+    for (uint8_t i = 0; i < LP_COUNT; ++i)
+    {
+        char title[256];
+        uint8_t len = 0;
+        if (!_read(&len, 1) || !_read(title, len))
+            return _fail("truncated schema");
+        cols.titles[i].assign(title, len);
+    }
+
+    uint32_t radio_count = 0;
+    if (!_read(&radio_count, sizeof(uint32_t)) || radio_count > BLOG_MAX_RADIOS)
+        return _fail("bad schema radio count");
+    schema.radios.resize(radio_count);
+    for (uint32_t i = 0; i < radio_count; ++i)
+    {
+        Binary_Log_Radio & rad = schema.radios[i];
+        if (!_read(rad.serial, BLOG_SERIAL_SIZE) || !_read(&rad.freq_mhz, sizeof(float)))
+            return _fail("truncated schema");
+        rad.serial[BLOG_SERIAL_SIZE - 1] = 0;
+    }
+
+    m_schema = schema;
+    m_values.resize(m_schema.values_size());
+    m_have_schema = true;
+    return Schema;
+}
+
+Binary_Log_Reader::Block Binary_Log_Reader::_read_record()
+{
+    if (!m_have_schema)
+        return _fail("record before any schema");
+
+    int32_t wall_delta = 0;
+    int32_t elapsed_delta = 0;
+    if (!_read(&wall_delta, sizeof(int32_t)) || !_read(&elapsed_delta, sizeof(int32_t)) || !_read(m_values.data(), m_values.size()))
+        return _fail("truncated record");
+    m_schema.wall_time += wall_delta;
+    m_schema.elapsed_ms += elapsed_delta;
+    return Record;
+}
+
+bool Binary_Log_Reader::_read(void * data, uint32_t size)
+{
+    return size == 0 || fread(data, 1, size, m_file) == size;
+}
+
+Binary_Log_Reader::Block Binary_Log_Reader::_fail(const std::string & msg)
+{
+    m_error = msg;
+    return Error;
+}
+
+const Binary_Log_Schema & Binary_Log_Reader::schema() const
+{
+    return m_schema;
+}
+
+time_t Binary_Log_Reader::wall_time() const
+{
+    return time_t(m_schema.wall_time);
+}
+
+double Binary_Log_Reader::elapsed_s() const
+{
+    return m_schema.elapsed_ms / 1000.0;
+}
+
+const uint8_t * Binary_Log_Reader::values() const
+{
+    return m_values.data();
+}
+
+const std::string & Binary_Log_Reader::error() const
+{
+    return m_error;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+
+#include "log_format.h"
+
+/*
+ Binary radio log - an append only stream of blocks, each starting with a tag byte. Everything is in host byte order
+ (little endian on the Pi and on x86).
+
+ Schema block - describes the records that follow it
+   'S', "RMLG", version (u8), flags (u8), wall time (i64 s), elapsed (i64 ms),
+   tx column count (u8), tx column params (u8 each), rx column count (u8), rx column params (u8 each),
+   a title for every Log_Param (u8 length then the chars), radio count (u32),
+   then for each radio its serial (BLOG_SERIAL_SIZE chars, nul padded) and freq (f32 MHz)
+
+ Record block - one logged row, a fixed size for a given schema
+   'R', wall time delta (i32 s), elapsed delta (i32 ms),
+   then for each radio in schema order the value of each of its columns - u8 for status params, f32 for the rest
+
+ Record times are deltas from the block before (schema or record), so a new schema is written whenever the radios
+ change, a delta won't fit, or the file is opened fresh. Only schemas with BLOG_FLAG_HEADER set correspond to a csv
+ header - the rest are just there to keep the records decodable.
+ */
+
+#define BINARY_LOG_EXTENSION ".rmlog"
+
+const char BLOG_MAGIC[] = "RMLG";
+const uint8_t BLOG_VERSION = 1;
+const uint8_t BLOG_SCHEMA_TAG = 'S';
+const uint8_t BLOG_RECORD_TAG = 'R';
+const uint8_t BLOG_FLAG_HEADER = 1;
+const uint8_t BLOG_SERIAL_SIZE = 16;
+const uint32_t BLOG_MAX_RADIOS = 65536;
+
+struct Binary_Log_Radio
+{
+    char serial[BLOG_SERIAL_SIZE];
+    float freq_mhz;
+};
+
+/// A schema block, plus the clock as of the latest block so both ends can work out the deltas
+struct Binary_Log_Schema
+{
+    Binary_Log_Schema();
+
+    /// Size of the values part of each record
+    uint32_t values_size() const;
+
+    uint8_t flags;
+    Log_Columns columns;
+    std::vector<Binary_Log_Radio> radios;
+
+    int64_t wall_time;
+    int64_t elapsed_ms;
+};
+
+namespace blog
+{
+/// Bytes param takes up in a record
+uint8_t value_size(uint8_t param);
+
+/// Set schema's clock to the given time and append it as a schema block
+void append_schema(Binary_Log_Schema * schema, time_t wall_time, double elapsed_s, std::string * out);
+
+/// Append the start of a record and advance schema's clock - returns false (appending nothing) if either delta won't
+/// fit, in which case a new schema needs appending first
+bool append_record_start(Binary_Log_Schema * schema, time_t wall_time, double elapsed_s, std::string * out);
+
+/// Append a record value - call for each column of each radio after append_record_start
+void append_value(uint8_t param, float value, std::string * out);
+
+/// Read back a value written by append_value
+float read_value(uint8_t param, const uint8_t * data);
+} // namespace blog
+
+/// Reads the blocks of a binary log one at a time
+class Binary_Log_Reader
+{
+  public:
+    enum Block
+    {
+        Schema,
+        Record,
+        End,
+        Error
+    };
+
+    Binary_Log_Reader();
+    ~Binary_Log_Reader();
+
+    bool open(const std::string & fname);
+
+    void close();
+
+    /// Read the next block - after a Schema schema() is the new schema, after a Record the record times and values()
+    /// are its contents. Error leaves a message in error()
+    Block next();
+
+    const Binary_Log_Schema & schema() const;
+
+    time_t wall_time() const;
+
+    double elapsed_s() const;
+
+    /// The latest record's values - read them a column at a time with blog::read_value
+    const uint8_t * values() const;
+
+    const std::string & error() const;
+
+  private:
+    Binary_Log_Reader(const Binary_Log_Reader &);
+    Binary_Log_Reader & operator=(const Binary_Log_Reader &);
+
+    Block _read_schema();
+    Block _read_record();
+    bool _read(void * data, uint32_t size);
+    Block _fail(const std::string & msg);
+
+    FILE * m_file;
+    Binary_Log_Schema m_schema;
+    bool m_have_schema;
+    std::vector<uint8_t> m_values;
+    std::string m_error;
+};
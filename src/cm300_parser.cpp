@@ -0,0 +1,242 @@
+#include <string.h>
+
+#include "cm300_parser.h"
+#include "radio_telnet.h"
+
+#define KEY_IS(str) (memcmp(m_key, str, sizeof(str) - 1) == 0)
+#define VALUE_IS(str) (m_value_len == sizeof(str) - 1 && memcmp(m_value, str, sizeof(str) - 1) == 0)
+
+static const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18};
+static const int32_t POW10_COUNT = sizeof(POW10) / sizeof(double);
+
+// Assign only if the value is different, touching the radio's telemetry row so loggers know to look at it again
+static void set_float(const char * str, uint32_t len, float * dest, CM300_Radio * radio)
+{
+    float val = *dest;
+    if (CM300_Parser::parse_float(str, len, &val) && val != *dest)
+    {
+        *dest = val;
+        radio->telemetry->touch(radio->row);
+    }
+}
+
+static void set_status(uint8_t val, uint8_t * dest, CM300_Radio * radio)
+{
+    if (val != *dest)
+    {
+        *dest = val;
+        radio->telemetry->touch(radio->row);
+    }
+}
+
+CM300_Parser::CM300_Parser() : m_key{0}, m_value{0}, m_key_len(0), m_value_len(0), m_in_value(false), m_overflow(false)
+{}
+
+void CM300_Parser::reset()
+{
+    m_key_len = 0;
+    m_value_len = 0;
+    m_in_value = false;
+    m_overflow = false;
+}
+
+void CM300_Parser::parse(const uint8_t * data, uint32_t size, CM300_Radio * radio)
+{
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        char c = data[i];
+        if (c == '\n')
+        {
+            _end_line(radio);
+        }
+        else if (c <= ' ' || m_overflow)
+        {
+            // Skip whitespace/control chars, and the rest of any line too long to be one we care about
+        }
+        else if (!m_in_value && c == ':')
+        {
+            m_in_value = true;
+        }
+        else if (m_in_value)
+        {
+            if (m_value_len < CM300_MAX_VALUE_LEN)
+                m_value[m_value_len++] = c;
+            else
+                m_overflow = true;
+        }
+        else
+        {
+            if (m_key_len < CM300_MAX_KEY_LEN)
+                m_key[m_key_len++] = c;
+            else
+                m_overflow = true;
+        }
+    }
+}
+
+void CM300_Parser::_end_line(CM300_Radio * radio)
+{
+    if (!m_in_value || m_overflow)
+    {
+        reset();
+        return;
+    }
+
+    // Switch on length first so at most a couple of keys ever get compared
+    switch (m_key_len)
+    {
+    case 3:
+        if (KEY_IS("SWR"))
+            set_float(m_value, m_value_len, &radio->telemetry->vswr[radio->row], radio);
+        else if (KEY_IS("AGC"))
+            set_float(m_value, m_value_len, &radio->telemetry->agc[radio->row], radio);
+        break;
+    case 7:
+        if (KEY_IS("RADIOID"))
+        {
+            // Only touch the string when it actually changes - it almost never does
+            if (radio->serial.size() != m_value_len || memcmp(radio->serial.data(), m_value, m_value_len) != 0)
+            {
+                radio->serial.assign(m_value, m_value_len);
+                radio->telemetry->is_tx[radio->row] = radio->is_tx();
+                radio->telemetry->touch(radio->row);
+            }
+        }
+        break;
+    case 9:
+        if (KEY_IS("LINELEVEL"))
+        {
+            set_float(m_value, m_value_len, &radio->telemetry->line_level[radio->row], radio);
+        }
+        else if (KEY_IS("PTTSTATUS"))
+        {
+            if (VALUE_IS("OFF"))
+                set_status(PTT_OFF, &radio->telemetry->ptt_status[radio->row], radio);
+            else if (VALUE_IS("LOCAL"))
+                set_status(PTT_LOCAL, &radio->telemetry->ptt_status[radio->row], radio);
+            else if (VALUE_IS("REMOTE"))
+                set_status(PTT_REMOTE, &radio->telemetry->ptt_status[radio->row], radio);
+            else if (VALUE_IS("TESTRF"))
+                set_status(PTT_TEST_RF, &radio->telemetry->ptt_status[radio->row], radio);
+            else
+                set_status(INVALID_VALUE, &radio->telemetry->ptt_status[radio->row], radio);
+        }
+        break;
+    case 12:
+        if (KEY_IS("FORWARDPOWER"))
+            set_float(m_value, m_value_len, &radio->telemetry->forward_power[radio->row], radio);
+        break;
+    case 14:
+        if (KEY_IS("REFLECTEDPOWER"))
+            set_float(m_value, m_value_len, &radio->telemetry->reverse_power[radio->row], radio);
+        break;
+    case 18:
+        if (KEY_IS("OPERATINGFREQUENCY"))
+        {
+            set_float(m_value, m_value_len, &radio->telemetry->freq_mhz[radio->row], radio);
+        }
+        else if (KEY_IS("SQUELCHBREAKSTATUS"))
+        {
+            if (VALUE_IS("CLOSED"))
+                set_status(SQUELCH_CLOSED, &radio->telemetry->squelch_status[radio->row], radio);
+            else if (VALUE_IS("OPEN"))
+                set_status(SQUELCH_OPEN, &radio->telemetry->squelch_status[radio->row], radio);
+            else
+                set_status(INVALID_VALUE, &radio->telemetry->squelch_status[radio->row], radio);
+        }
+        break;
+    default:
+        // Skip - no need to update anything
+        break;
+    }
+    reset();
+}
+
+bool CM300_Parser::parse_float(const char * str, uint32_t len, float * val)
+{
+    uint32_t i = 0;
+    bool neg = false;
+    if (i < len && (str[i] == '-' || str[i] == '+'))
+    {
+        neg = (str[i] == '-');
+        ++i;
+    }
+
+    // Accumulate up to 18 significant digits as an integer and track where the decimal point goes
+    uint64_t mantissa = 0;
+    int32_t sig_digits = 0;
+    int32_t exp10 = 0;
+    bool have_digits = false;
+    while (i < len && str[i] >= '0' && str[i] <= '9')
+    {
+        if (sig_digits < POW10_COUNT - 1)
+        {
+            mantissa = mantissa * 10 + (str[i] - '0');
+            if (mantissa != 0)
+                ++sig_digits;
+        }
+        else
+        {
+            ++exp10;
+        }
+        have_digits = true;
+        ++i;
+    }
+    if (i < len && str[i] == '.')
+    {
+        ++i;
+        while (i < len && str[i] >= '0' && str[i] <= '9')
+        {
+            if (sig_digits < POW10_COUNT - 1)
+            {
+                mantissa = mantissa * 10 + (str[i] - '0');
+                if (mantissa != 0)
+                    ++sig_digits;
+                --exp10;
+            }
+            have_digits = true;
+            ++i;
+        }
+    }
+    if (!have_digits)
+        return false;
+
+    // Only take an exponent if digits follow it - otherwise the e is the start of a unit suffix
+    if (i + 1 < len && (str[i] == 'e' || str[i] == 'E'))
+    {
+        uint32_t j = i + 1;
+        bool exp_neg = false;
+        if (str[j] == '-' || str[j] == '+')
+        {
+            exp_neg = (str[j] == '-');
+            ++j;
+        }
+        if (j < len && str[j] >= '0' && str[j] <= '9')
+        {
+            int32_t e = 0;
+            while (j < len && str[j] >= '0' && str[j] <= '9')
+            {
+                if (e < 1000)
+                    e = e * 10 + (str[j] - '0');
+                ++j;
+            }
+            exp10 += exp_neg ? -e : e;
+        }
+    }
+
+    double result = double(mantissa);
+    while (exp10 > 0)
+    {
+        int32_t step = (exp10 < POW10_COUNT) ? exp10 : POW10_COUNT - 1;
+        result *= POW10[step];
+        exp10 -= step;
+    }
+    while (exp10 < 0)
+    {
+        int32_t step = (-exp10 < POW10_COUNT) ? -exp10 : POW10_COUNT - 1;
+        result /= POW10[step];
+        exp10 += step;
+    }
+    *val = float(neg ? -result : result);
+    return true;
+}
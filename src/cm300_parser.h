@@ -0,0 +1,37 @@
+#pragma once
+
+#include <inttypes.h>
+
+#define CM300_MAX_KEY_LEN 32
+#define CM300_MAX_VALUE_LEN 48
+
+struct CM300_Radio;
+
+/// Streaming parser for CM300 telnet responses. A response is lines of KEY:VALUE - bytes can be fed in any sized
+/// pieces and each line is applied to the radio as soon as its newline arrives, with a partial line carried over to
+/// the next call. Whitespace is dropped, keys are matched on length then content, and numbers are parsed in place
+/// so nothing is allocated. Values are only assigned when they differ, and each change touches the radio's telemetry row.
+class CM300_Parser
+{
+  public:
+    CM300_Parser();
+
+    void parse(const uint8_t * data, uint32_t size, CM300_Radio * radio);
+
+    /// Drop any partial line - call at the end of each response so the prompt isn't taken as the start of a key
+    void reset();
+
+    /// Parse the leading number in str (sign, digits, fraction and exponent) ignoring any unit suffix - returns
+    /// false and leaves val alone if str doesn't start with a number
+    static bool parse_float(const char * str, uint32_t len, float * val);
+
+  private:
+    void _end_line(CM300_Radio * radio);
+
+    char m_key[CM300_MAX_KEY_LEN];
+    char m_value[CM300_MAX_VALUE_LEN];
+    uint8_t m_key_len;
+    uint8_t m_value_len;
+    bool m_in_value;
+    bool m_overflow;
+};
@@ -48,7 +48,5 @@ class Config_File
     std::string dump();
 
   private:
-    void _strip_comments(std::string & str);
-    void _strip_empty_lines(std::string & str);
     nlohmann::json _config_obj;
 };
\ No newline at end of file
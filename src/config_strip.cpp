@@ -0,0 +1,61 @@
+#include "config_strip.h"
+
+void strip_config_comments(const std::string & in, std::string * out)
+{
+    // One pass - "//" starts a comment unless it's inside a string (ie a url), and lines left with nothing but
+    // whitespace are dropped along with their line ending
+    out->clear();
+    out->reserve(in.size());
+
+    size_t line_start = 0;
+    bool blank = true;
+    bool in_string = false;
+    bool escaped = false;
+    size_t i = 0;
+    while (i < in.size())
+    {
+        char c = in[i];
+        if (c == '\n')
+        {
+            if (blank)
+                out->resize(line_start);
+            else
+                out->push_back(c);
+            line_start = out->size();
+            blank = true;
+            in_string = false;
+            escaped = false;
+            ++i;
+            continue;
+        }
+
+        if (in_string)
+        {
+            if (escaped)
+                escaped = false;
+            else if (c == '\\')
+                escaped = true;
+            else if (c == '"')
+                in_string = false;
+        }
+        else if (c == '/' && i + 1 < in.size() && in[i + 1] == '/')
+        {
+            // Skip to the line ending - it's handled above
+            size_t nlpos = in.find('\n', i);
+            i = (nlpos == std::string::npos) ? in.size() : nlpos;
+            continue;
+        }
+        else if (c == '"')
+        {
+            in_string = true;
+        }
+
+        if (c != ' ' && c != '\t' && c != '\r')
+            blank = false;
+        out->push_back(c);
+        ++i;
+    }
+
+    if (blank)
+        out->resize(line_start);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+/// Copy in to out without "//" comments (outside of strings) or blank lines - kept free of spdlog so the tools can
+/// link it
+void strip_config_comments(const std::string & in, std::string * out);
@@ -0,0 +1,176 @@
+#include <string.h>
+#include <errno.h>
+
+#include "drive_worker.h"
+#include "config_file.h"
+#include "main_control.h"
+#include "logger.h"
+
+Drive_Job::Drive_Job(Type type_) : type(type_), cfg(nullptr), cfg_loaded(false), done()
+{
+    if (type == Mount)
+        cfg = new Config_File;
+}
+
+Drive_Job::~Drive_Job()
+{
+    delete cfg;
+}
+
+Drive_Worker::Drive_Worker() : m_queued(), m_finished(), m_in_progress(0), m_running(false), m_thread(0)
+{
+    pthread_mutex_init(&m_lock, nullptr);
+    pthread_cond_init(&m_cond, nullptr);
+}
+
+Drive_Worker::~Drive_Worker()
+{
+    stop();
+    pthread_cond_destroy(&m_cond);
+    pthread_mutex_destroy(&m_lock);
+}
+
+bool Drive_Worker::start()
+{
+    if (m_running)
+        return false;
+
+    m_running = true;
+    if (pthread_create(&m_thread, nullptr, Drive_Worker::thread_exec, (void *)this) != 0)
+    {
+        elog("Could not create usb drive worker thread: {}", strerror(errno));
+        m_running = false;
+        m_thread = 0;
+        return false;
+    }
+    ilog("Started usb drive worker");
+    return true;
+}
+
+void Drive_Worker::stop()
+{
+    if (!m_running)
+        return;
+
+    pthread_mutex_lock(&m_lock);
+    m_running = false;
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_lock);
+    pthread_join(m_thread, nullptr);
+    m_thread = 0;
+    _clear();
+    ilog("Stopped usb drive worker");
+}
+
+bool Drive_Worker::running()
+{
+    return m_running;
+}
+
+void Drive_Worker::mount(const std::function<void(Drive_Job *)> & done)
+{
+    Drive_Job * job = new Drive_Job(Drive_Job::Mount);
+    job->done = done;
+    _queue(job);
+}
+
+void Drive_Worker::unmount(const std::function<void(Drive_Job *)> & done)
+{
+    Drive_Job * job = new Drive_Job(Drive_Job::Unmount);
+    job->done = done;
+    _queue(job);
+}
+
+bool Drive_Worker::busy()
+{
+    pthread_mutex_lock(&m_lock);
+    bool ret = !m_queued.empty() || !m_finished.empty() || m_in_progress > 0;
+    pthread_mutex_unlock(&m_lock);
+    return ret;
+}
+
+void Drive_Worker::update()
+{
+    std::vector<Drive_Job *> finished;
+    pthread_mutex_lock(&m_lock);
+    finished.swap(m_finished);
+    pthread_mutex_unlock(&m_lock);
+
+    // Callbacks can queue more jobs so they're called without the lock held
+    for (uint32_t i = 0; i < finished.size(); ++i)
+    {
+        if (finished[i]->done)
+            finished[i]->done(finished[i]);
+        delete finished[i];
+    }
+}
+
+void Drive_Worker::_queue(Drive_Job * job)
+{
+    if (!m_running)
+    {
+        wlog("Usb drive worker isn't running - dropping {} job", job->type == Drive_Job::Mount ? "mount" : "unmount");
+        delete job;
+        return;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    m_queued.push_back(job);
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_lock);
+}
+
+void Drive_Worker::_clear()
+{
+    pthread_mutex_lock(&m_lock);
+    while (!m_queued.empty())
+    {
+        delete m_queued.front();
+        m_queued.pop_front();
+    }
+    for (uint32_t i = 0; i < m_finished.size(); ++i)
+        delete m_finished[i];
+    m_finished.clear();
+    pthread_mutex_unlock(&m_lock);
+}
+
+void Drive_Worker::_exec()
+{
+    pthread_mutex_lock(&m_lock);
+    while (m_running)
+    {
+        if (m_queued.empty())
+        {
+            pthread_cond_wait(&m_cond, &m_lock);
+            continue;
+        }
+
+        Drive_Job * job = m_queued.front();
+        m_queued.pop_front();
+        ++m_in_progress;
+        pthread_mutex_unlock(&m_lock);
+
+        if (job->type == Drive_Job::Mount)
+        {
+            edm.mount_drive();
+            job->cfg_loaded = edm.load_config(job->cfg);
+        }
+        else
+        {
+            edm.unmount_drive();
+        }
+
+        pthread_mutex_lock(&m_lock);
+        --m_in_progress;
+        m_finished.push_back(job);
+        edm.wake();
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+void * Drive_Worker::thread_exec(void * _this)
+{
+    Drive_Worker * worker = static_cast<Drive_Worker *>(_this);
+    worker->_exec();
+    return nullptr;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <pthread.h>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <atomic>
+
+class Config_File;
+
+/// A finished mount or unmount - cfg is only loaded for mounts
+struct Drive_Job
+{
+    enum Type
+    {
+        Mount,
+        Unmount
+    };
+
+    Drive_Job(Type type_ = Mount);
+    ~Drive_Job();
+
+    Type type;
+    Config_File * cfg;
+    bool cfg_loaded;
+    std::function<void(Drive_Job *)> done;
+};
+
+/// Mounts and unmounts the usb drive (and loads the config from it) on its own thread - mounting can take seconds of
+/// retries and waiting for the drive to settle, and the main loop needs to keep polling the radios meanwhile. Jobs are
+/// run one at a time in the order they were queued, and their done callbacks are called from the main loop's update
+/// once they finish.
+class Drive_Worker
+{
+  public:
+    Drive_Worker();
+    ~Drive_Worker();
+
+    bool start();
+
+    /// Finish the job in progress and stop - jobs still queued or finished are dropped without calling done
+    void stop();
+
+    bool running();
+
+    /// Queue mounting the drive and loading the config
+    void mount(const std::function<void(Drive_Job *)> & done);
+
+    /// Queue unmounting the drive
+    void unmount(const std::function<void(Drive_Job *)> & done);
+
+    /// Whether any job is queued, in progress, or waiting for its done callback
+    bool busy();
+
+    /// Call the done callbacks of finished jobs - main loop only
+    void update();
+
+  private:
+    void _queue(Drive_Job * job);
+    void _clear();
+    void _exec();
+
+    static void * thread_exec(void *);
+
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_cond;
+    std::deque<Drive_Job *> m_queued;
+    std::vector<Drive_Job *> m_finished;
+    uint32_t m_in_progress;
+
+    std::atomic_bool m_running;
+    pthread_t m_thread;
+};
@@ -0,0 +1,268 @@
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "fd_reactor.h"
+#include "threaded_fd.h"
+#include "logger.h"
+
+Fd_Reactor::Fd_Reactor() : m_workers(), m_running(false)
+{}
+
+Fd_Reactor::~Fd_Reactor()
+{
+    stop();
+}
+
+bool Fd_Reactor::start(uint32_t worker_count)
+{
+    if (m_running)
+        return false;
+
+    if (worker_count == 0)
+        worker_count = 1;
+
+    m_running = true;
+    for (uint32_t i = 0; i < worker_count; ++i)
+    {
+        Worker * worker = new Worker;
+        worker->reactor = this;
+        pthread_mutex_init(&worker->lock, nullptr);
+        m_workers.push_back(worker);
+
+        worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        worker->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (worker->epoll_fd == -1 || worker->wake_fd == -1)
+        {
+            elog("Could not create epoll/event fd for reactor worker {}: {}", i, strerror(errno));
+            _release_workers();
+            return false;
+        }
+
+        // The wake fd is the only fd registered with a null data ptr
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->wake_fd, &ev);
+
+        if (pthread_create(&worker->thread, nullptr, Fd_Reactor::thread_exec, (void *)worker) != 0)
+        {
+            elog("Could not create thread for reactor worker {}: {}", i, strerror(errno));
+            worker->thread = 0;
+            _release_workers();
+            return false;
+        }
+    }
+    ilog("Started fd reactor with {} worker thread(s)", worker_count);
+    return true;
+}
+
+void Fd_Reactor::stop()
+{
+    if (!m_running)
+        return;
+    ilog("Stopping fd reactor with {} worker thread(s)", m_workers.size());
+    _release_workers();
+}
+
+void Fd_Reactor::_release_workers()
+{
+    m_running = false;
+    for (size_t i = 0; i < m_workers.size(); ++i)
+    {
+        uint64_t val = 1;
+        if (m_workers[i]->wake_fd != -1)
+            ::write(m_workers[i]->wake_fd, &val, sizeof(val));
+    }
+
+    for (size_t i = 0; i < m_workers.size(); ++i)
+    {
+        Worker * worker = m_workers[i];
+        if (worker->thread)
+            pthread_join(worker->thread, nullptr);
+
+        // Anything still registered is orphaned - make sure the handles know it
+        auto iter = worker->handles.begin();
+        while (iter != worker->handles.end())
+        {
+            (*iter)->m_reactor_worker = -1;
+            ++iter;
+        }
+
+        if (worker->epoll_fd != -1)
+            close(worker->epoll_fd);
+        if (worker->wake_fd != -1)
+            close(worker->wake_fd);
+        pthread_mutex_destroy(&worker->lock);
+        delete worker;
+    }
+    m_workers.clear();
+}
+
+bool Fd_Reactor::running()
+{
+    return m_running;
+}
+
+uint32_t Fd_Reactor::worker_count()
+{
+    return m_workers.size();
+}
+
+bool Fd_Reactor::add(Threaded_Fd * handle)
+{
+    if (!m_running || handle->fd() == -1)
+        return false;
+
+    // Pick the worker servicing the fewest fds
+    int32_t ind = 0;
+    size_t min_count = -1;
+    for (size_t i = 0; i < m_workers.size(); ++i)
+    {
+        pthread_mutex_lock(&m_workers[i]->lock);
+        size_t cnt = m_workers[i]->handles.size();
+        pthread_mutex_unlock(&m_workers[i]->lock);
+        if (cnt < min_count)
+        {
+            min_count = cnt;
+            ind = i;
+        }
+    }
+
+    Worker * worker = m_workers[ind];
+    pthread_mutex_lock(&worker->lock);
+    handle->m_write_armed = true;
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.ptr = handle;
+    bool ret = (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, handle->fd(), &ev) == 0);
+    if (ret)
+    {
+        worker->handles.insert(handle);
+        handle->m_reactor_worker = ind;
+    }
+    else
+    {
+        elog("Could not add fd {} to reactor worker {}: {}", handle->fd(), ind, strerror(errno));
+        handle->m_write_armed = false;
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return ret;
+}
+
+void Fd_Reactor::remove(Threaded_Fd * handle)
+{
+    int32_t ind = handle->m_reactor_worker.exchange(-1);
+    if (ind < 0 || ind >= int32_t(m_workers.size()))
+    {
+        // A worker may have dropped the handle on its own (ie connection closed) - make sure it is done with it
+        for (size_t i = 0; i < m_workers.size(); ++i)
+        {
+            pthread_mutex_lock(&m_workers[i]->lock);
+            pthread_mutex_unlock(&m_workers[i]->lock);
+        }
+        return;
+    }
+
+    Worker * worker = m_workers[ind];
+    pthread_mutex_lock(&worker->lock);
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, handle->fd(), nullptr);
+    worker->handles.erase(handle);
+    worker->waiting.erase(handle);
+    handle->m_write_armed = false;
+    pthread_mutex_unlock(&worker->lock);
+}
+
+void Fd_Reactor::_watch_write(Threaded_Fd * handle, bool enable)
+{
+    int32_t ind = handle->m_reactor_worker;
+    if (ind < 0 || ind >= int32_t(m_workers.size()))
+        return;
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    if (enable)
+        ev.events |= EPOLLOUT;
+    ev.data.ptr = handle;
+    epoll_ctl(m_workers[ind]->epoll_fd, EPOLL_CTL_MOD, handle->fd(), &ev);
+}
+
+void Fd_Reactor::_after_service(Worker * worker, Threaded_Fd * handle)
+{
+    if (!handle->running())
+    {
+        ilog("Reactor dropping fd {} - {}", handle->fd(), Threaded_Fd::error_string(handle->error()));
+        epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, handle->fd(), nullptr);
+        worker->handles.erase(handle);
+        worker->waiting.erase(handle);
+        handle->m_write_armed = false;
+        // Must be the last touch of handle - remove() on another thread relies on it
+        handle->m_reactor_worker = -1;
+        return;
+    }
+
+    if (handle->_waiting_for_response())
+        worker->waiting.insert(handle);
+    else
+        worker->waiting.erase(handle);
+    handle->_update_write_interest();
+}
+
+void Fd_Reactor::_exec(Worker * worker)
+{
+    epoll_event events[REACTOR_MAX_EVENTS];
+    while (m_running)
+    {
+        // Only wake up on a timeout if someone is waiting on a command response
+        pthread_mutex_lock(&worker->lock);
+        int32_t timeout = worker->waiting.empty() ? -1 : COMMAND_WAIT_DELAY;
+        pthread_mutex_unlock(&worker->lock);
+
+        int32_t cnt = epoll_wait(worker->epoll_fd, events, REACTOR_MAX_EVENTS, timeout);
+        if (cnt < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            elog("Reactor epoll_wait failed: {}", strerror(errno));
+            break;
+        }
+
+        pthread_mutex_lock(&worker->lock);
+        for (int32_t i = 0; i < cnt; ++i)
+        {
+            Threaded_Fd * handle = static_cast<Threaded_Fd *>(events[i].data.ptr);
+            if (!handle)
+            {
+                uint64_t val;
+                ::read(worker->wake_fd, &val, sizeof(val));
+                continue;
+            }
+
+            // The handle may have been removed after epoll_wait returned
+            if (worker->handles.find(handle) == worker->handles.end())
+                continue;
+
+            handle->_service(events[i].events);
+            _after_service(worker, handle);
+        }
+
+        auto iter = worker->waiting.begin();
+        while (iter != worker->waiting.end())
+        {
+            Threaded_Fd * handle = *iter;
+            ++iter;
+            handle->_service(0);
+            _after_service(worker, handle);
+        }
+        pthread_mutex_unlock(&worker->lock);
+    }
+}
+
+void * Fd_Reactor::thread_exec(void * _worker)
+{
+    Worker * worker = static_cast<Worker *>(_worker);
+    worker->reactor->_exec(worker);
+    return nullptr;
+}
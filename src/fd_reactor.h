@@ -0,0 +1,64 @@
+#pragma once
+
+#include <pthread.h>
+#include <inttypes.h>
+#include <set>
+#include <vector>
+#include <atomic>
+
+#define DEFAULT_REACTOR_WORKER_COUNT 1
+#define REACTOR_MAX_EVENTS 64
+
+class Threaded_Fd;
+
+/// Event driven io backend for Threaded_Fd. Instead of every fd owning a thread that spins on its fd, fds are
+/// registered with the reactor which blocks in epoll_wait and only services the fds that are ready. Each worker
+/// owns its own epoll set and every registered fd is serviced by exactly one worker, so per fd io state is only
+/// ever touched from a single io thread.
+class Fd_Reactor
+{
+  public:
+    Fd_Reactor();
+    ~Fd_Reactor();
+
+    bool start(uint32_t worker_count = DEFAULT_REACTOR_WORKER_COUNT);
+
+    void stop();
+
+    bool running();
+
+    uint32_t worker_count();
+
+    /// Register handle with the least loaded worker - handle must already have a valid fd
+    bool add(Threaded_Fd * handle);
+
+    /// Unregister handle - once this returns no worker is touching handle and it is safe to delete
+    void remove(Threaded_Fd * handle);
+
+  private:
+    friend class Threaded_Fd;
+
+    struct Worker
+    {
+        Worker() : reactor(nullptr), epoll_fd(-1), wake_fd(-1), thread(0), handles(), waiting()
+        {}
+
+        Fd_Reactor * reactor;
+        int32_t epoll_fd;
+        int32_t wake_fd;
+        pthread_t thread;
+        pthread_mutex_t lock;
+        std::set<Threaded_Fd *> handles;
+        std::set<Threaded_Fd *> waiting;
+    };
+
+    void _watch_write(Threaded_Fd * handle, bool enable);
+    void _after_service(Worker * worker, Threaded_Fd * handle);
+    void _exec(Worker * worker);
+    void _release_workers();
+
+    static void * thread_exec(void *);
+
+    std::vector<Worker *> m_workers;
+    std::atomic_bool m_running;
+};
@@ -0,0 +1,517 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <zlib.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <algorithm>
+
+#include "log_archiver.h"
+#include "config_file.h"
+#include "utility.h"
+#include "logger.h"
+
+// From linux/ioprio.h, which isn't always installed
+#define ARCHIVER_IOPRIO_WHO_PROCESS 1
+#define ARCHIVER_IOPRIO_CLASS_IDLE 3
+#define ARCHIVER_IOPRIO_CLASS_SHIFT 13
+#define ARCHIVER_NICE 19
+
+static const std::string TMP_EXTENSION = ".tmp";
+
+static bool ends_with(const std::string & str, const std::string & suffix)
+{
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static bool write_all(int32_t fd, const uint8_t * data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t cnt = ::write(fd, data, size);
+        if (cnt < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += cnt;
+        size -= cnt;
+    }
+    return true;
+}
+
+Log_Archive_Config::Log_Archive_Config()
+    : max_file_size_kb(DEFAULT_LOG_MAX_FILE_SIZE_KB),
+      compress(true),
+      disk_budget_mb(DEFAULT_LOG_DISK_BUDGET_MB),
+      max_age_days(0),
+      scan_period_s(DEFAULT_LOG_SCAN_PERIOD_S)
+{}
+
+bool fill_log_archive_config_if_found(Config_File * cfg, const std::string & name, Log_Archive_Config * acfg)
+{
+    nlohmann::json obj;
+    if (!cfg->fill_param_if_found(name, &obj))
+        return false;
+
+    try
+    {
+        fill_param_if_found(obj, "max_file_size_kb", &acfg->max_file_size_kb);
+        fill_param_if_found(obj, "compress", &acfg->compress);
+        fill_param_if_found(obj, "disk_budget_mb", &acfg->disk_budget_mb);
+        fill_param_if_found(obj, "max_age_days", &acfg->max_age_days);
+        fill_param_if_found(obj, "scan_period_s", &acfg->scan_period_s);
+    }
+    catch (nlohmann::detail::exception & e)
+    {
+        elog("Error for {} - using max_file_size_kb {} compress {} disk_budget_mb {} max_age_days {} scan_period_s {}",
+             name,
+             acfg->max_file_size_kb,
+             acfg->compress,
+             acfg->disk_budget_mb,
+             acfg->max_age_days,
+             acfg->scan_period_s);
+        return false;
+    }
+
+    if (acfg->scan_period_s == 0)
+        acfg->scan_period_s = 1;
+    return true;
+}
+
+std::string log_part_fname(const std::string & base, uint32_t part, const std::string & ext)
+{
+    if (part <= 1)
+        return base + ext;
+    return base + " part " + std::to_string(part) + ext;
+}
+
+uint32_t claim_log_part(Log_Archiver * archiver,
+                        const void * owner,
+                        const std::string & base,
+                        const std::string & ext,
+                        uint32_t first_part,
+                        uint64_t max_size,
+                        std::string * fname)
+{
+    uint32_t part = std::max(first_part, uint32_t(1));
+    while (true)
+    {
+        *fname = log_part_fname(base, part, ext);
+
+        // Claim before looking so the archiver can't compress it out from under us in between
+        if (archiver)
+            archiver->set_active(owner, *fname);
+        if (!util::path_exists(*fname + LOG_ARCHIVE_EXTENSION))
+        {
+            int64_t size = util::file_size(*fname);
+            if (max_size == 0 || size < int64_t(max_size))
+                return part;
+        }
+        ++part;
+    }
+}
+
+Log_Archiver::Log_Archiver()
+    : m_cfg(), m_watched(), m_active(), m_busy(), m_kicked(false), m_running(false), m_paused(false), m_thread(0)
+{
+    pthread_mutex_init(&m_lock, nullptr);
+
+    // Wait on the monotonic clock so wall clock changes don't stall or rush the scans
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&m_cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+Log_Archiver::~Log_Archiver()
+{
+    stop();
+    pthread_cond_destroy(&m_cond);
+    pthread_mutex_destroy(&m_lock);
+}
+
+bool Log_Archiver::start(const Log_Archive_Config & cfg)
+{
+    if (m_running)
+        return false;
+
+    // Files claimed and released before now are picked up by the first scan anyway
+    m_cfg = cfg;
+    pthread_mutex_lock(&m_lock);
+    m_kicked = false;
+    pthread_mutex_unlock(&m_lock);
+    if (!m_cfg.compress && m_cfg.disk_budget_mb == 0 && m_cfg.max_age_days == 0)
+    {
+        ilog("Log compression, disk budget and max age are all off - not starting log archiver");
+        return false;
+    }
+
+    m_running = true;
+    if (pthread_create(&m_thread, nullptr, Log_Archiver::thread_exec, (void *)this) != 0)
+    {
+        elog("Could not create log archiver thread: {}", strerror(errno));
+        m_running = false;
+        m_thread = 0;
+        return false;
+    }
+    ilog("Started log archiver - compress {}  disk budget {} MB  max age {} days  max file size {} KB",
+         m_cfg.compress,
+         m_cfg.disk_budget_mb,
+         m_cfg.max_age_days,
+         m_cfg.max_file_size_kb);
+    return true;
+}
+
+void Log_Archiver::stop()
+{
+    if (!m_running)
+        return;
+
+    pthread_mutex_lock(&m_lock);
+    m_running = false;
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_lock);
+    pthread_join(m_thread, nullptr);
+    m_thread = 0;
+    ilog("Stopped log archiver");
+}
+
+bool Log_Archiver::running()
+{
+    return m_running;
+}
+
+const Log_Archive_Config & Log_Archiver::config() const
+{
+    return m_cfg;
+}
+
+void Log_Archiver::watch(const std::string & dir, const std::string & prefix)
+{
+    std::string path(dir);
+    while (path.size() > 1 && path.back() == '/')
+        path.pop_back();
+
+    pthread_mutex_lock(&m_lock);
+    m_watched.insert(std::make_pair(path, prefix));
+    pthread_mutex_unlock(&m_lock);
+}
+
+void Log_Archiver::set_active(const void * owner, const std::string & fname)
+{
+    pthread_mutex_lock(&m_lock);
+    while (!fname.empty() && m_busy == fname)
+        pthread_cond_wait(&m_cond, &m_lock);
+
+    // Moving on to another file means the last one is ready to be archived - no need to wait for the next scan. Just
+    // closing it (ie for shutdown or a drive change) doesn't count, as it will likely be reopened.
+    auto iter = m_active.find(owner);
+    if (iter != m_active.end() && !fname.empty() && iter->second != fname)
+    {
+        m_kicked = true;
+        pthread_cond_broadcast(&m_cond);
+    }
+
+    if (fname.empty())
+        m_active.erase(owner);
+    else
+        m_active[owner] = fname;
+    pthread_mutex_unlock(&m_lock);
+}
+
+void Log_Archiver::kick()
+{
+    pthread_mutex_lock(&m_lock);
+    m_kicked = true;
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_lock);
+}
+
+void Log_Archiver::pause()
+{
+    m_paused = true;
+    pthread_mutex_lock(&m_lock);
+    while (!m_busy.empty())
+        pthread_cond_wait(&m_cond, &m_lock);
+    pthread_mutex_unlock(&m_lock);
+}
+
+void Log_Archiver::resume()
+{
+    // Anything abandoned is picked up again on the next scan
+    m_paused = false;
+}
+
+void Log_Archiver::_list_files(std::vector<File_Info> * files)
+{
+    pthread_mutex_lock(&m_lock);
+    std::set<std::pair<std::string, std::string>> watched(m_watched);
+    pthread_mutex_unlock(&m_lock);
+
+    // The same dir can be watched for several prefixes (and a prefix can be a prefix of another)
+    std::set<std::string> seen;
+    auto iter = watched.begin();
+    while (iter != watched.end())
+    {
+        std::vector<std::string> names = util::filenames_in_dir(iter->first, iter->second);
+        for (size_t i = 0; i < names.size(); ++i)
+        {
+            if (names[i].compare(0, iter->second.size(), iter->second) != 0)
+                continue;
+
+            File_Info info;
+            info.path = iter->first + "/" + names[i];
+            struct stat st;
+            if (!seen.insert(info.path).second || stat(info.path.c_str(), &st) != 0)
+                continue;
+            info.size = st.st_size;
+            info.mtime = st.st_mtime;
+            files->push_back(info);
+        }
+        ++iter;
+    }
+}
+
+bool Log_Archiver::_active(const std::string & path)
+{
+    auto iter = m_active.begin();
+    while (iter != m_active.end())
+    {
+        if (iter->second == path)
+            return true;
+        ++iter;
+    }
+    return false;
+}
+
+bool Log_Archiver::_begin(const std::string & path)
+{
+    pthread_mutex_lock(&m_lock);
+    bool ok = !m_paused && !_active(path);
+    if (ok)
+        m_busy = path;
+    pthread_mutex_unlock(&m_lock);
+    return ok;
+}
+
+void Log_Archiver::_end()
+{
+    pthread_mutex_lock(&m_lock);
+    m_busy.clear();
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_lock);
+}
+
+bool Log_Archiver::_compress(File_Info * file, std::string * err)
+{
+    // Nothing is logged in here - logging can rotate the status log, which waits for us to finish with its file
+    int32_t in = open(file->path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in == -1)
+    {
+        *err = strerror(errno);
+        return false;
+    }
+
+    struct stat st;
+    fstat(in, &st);
+    std::string gz_path = file->path + LOG_ARCHIVE_EXTENSION;
+    std::string tmp_path = gz_path + TMP_EXTENSION;
+    int32_t out = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (out == -1)
+    {
+        *err = strerror(errno);
+        close(in);
+        return false;
+    }
+
+    // windowBits + 16 writes a gzip header and trailer so the result opens with gunzip/zcat
+    z_stream zs = {};
+    bool ok = deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    if (!ok)
+        *err = "could not init zlib";
+
+    std::vector<uint8_t> in_buf(LOG_ARCHIVE_CHUNK_SIZE);
+    std::vector<uint8_t> out_buf(LOG_ARCHIVE_CHUNK_SIZE);
+    int32_t flush = Z_NO_FLUSH;
+    while (ok && flush != Z_FINISH)
+    {
+        // Give up (leaving the file as is) rather than hold up a drive being unmounted or shutdown
+        if (m_paused || !m_running)
+        {
+            ok = false;
+            break;
+        }
+
+        ssize_t cnt = read(in, in_buf.data(), in_buf.size());
+        if (cnt < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            *err = strerror(errno);
+            ok = false;
+            break;
+        }
+
+        flush = (cnt == 0) ? Z_FINISH : Z_NO_FLUSH;
+        zs.next_in = in_buf.data();
+        zs.avail_in = cnt;
+        do
+        {
+            zs.next_out = out_buf.data();
+            zs.avail_out = out_buf.size();
+            deflate(&zs, flush);
+            size_t have = out_buf.size() - zs.avail_out;
+            if (have > 0 && !write_all(out, out_buf.data(), have))
+            {
+                *err = strerror(errno);
+                ok = false;
+                break;
+            }
+        } while (zs.avail_out == 0);
+    }
+    deflateEnd(&zs);
+    close(in);
+
+    // Keep the original's times so the age and budget checks still go by when it was written
+    timespec times[2] = {st.st_atim, st.st_mtim};
+    futimens(out, times);
+    if (ok && fsync(out) != 0)
+    {
+        *err = strerror(errno);
+        ok = false;
+    }
+    struct stat out_st;
+    fstat(out, &out_st);
+    close(out);
+
+    if (ok && rename(tmp_path.c_str(), gz_path.c_str()) != 0)
+    {
+        *err = strerror(errno);
+        ok = false;
+    }
+    if (!ok)
+    {
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    unlink(file->path.c_str());
+    file->path = gz_path;
+    file->size = out_st.st_size;
+    return true;
+}
+
+bool Log_Archiver::_remove(const File_Info & file)
+{
+    if (!_begin(file.path))
+        return false;
+    bool ok = unlink(file.path.c_str()) == 0;
+    _end();
+    return ok;
+}
+
+void Log_Archiver::_scan()
+{
+    std::vector<File_Info> files;
+    _list_files(&files);
+
+    // Compress everything nobody is writing to - a leftover .tmp is a compress that was cut short
+    std::vector<File_Info> kept;
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        if (!m_running || m_paused)
+            return;
+
+        File_Info & file = files[i];
+        if (ends_with(file.path, TMP_EXTENSION))
+        {
+            _remove(file);
+            continue;
+        }
+
+        if (m_cfg.compress && !ends_with(file.path, LOG_ARCHIVE_EXTENSION) && _begin(file.path))
+        {
+            File_Info orig(file);
+            std::string err;
+            bool ok = _compress(&file, &err);
+            _end();
+            if (ok)
+                ilog("Compressed {} ({} KB to {} KB)", orig.path, orig.size / 1024, file.size / 1024);
+            else if (!err.empty())
+                wlog("Could not compress {}: {}", orig.path, err);
+        }
+        kept.push_back(file);
+    }
+
+    // Oldest first - active files count towards the budget but are never removed
+    std::sort(kept.begin(), kept.end(), [](const File_Info & a, const File_Info & b) { return a.mtime < b.mtime; });
+    uint64_t total = 0;
+    for (size_t i = 0; i < kept.size(); ++i)
+        total += kept[i].size;
+
+    uint64_t budget = uint64_t(m_cfg.disk_budget_mb) * 1024 * 1024;
+    time_t oldest_allowed = time(nullptr) - time_t(m_cfg.max_age_days) * 24 * 3600;
+    for (size_t i = 0; i < kept.size(); ++i)
+    {
+        bool too_old = m_cfg.max_age_days > 0 && kept[i].mtime < oldest_allowed;
+        bool over_budget = budget > 0 && total > budget;
+        if (!too_old && !over_budget)
+            break;
+        if (!m_running || m_paused)
+            return;
+
+        if (_remove(kept[i]))
+        {
+            total -= kept[i].size;
+            ilog("Removed log {} ({} KB) - {}", kept[i].path, kept[i].size / 1024, too_old ? "past max age" : "over disk budget");
+        }
+    }
+
+    if (budget > 0 && total > budget)
+        wlog("Logs are still using {} MB (budget is {} MB) with nothing left to remove", total / (1024 * 1024), m_cfg.disk_budget_mb);
+}
+
+void Log_Archiver::_exec()
+{
+    // Compressing is never urgent - stay out of the way of the main loop and the log writer for both cpu and the card
+    pid_t tid = syscall(SYS_gettid);
+    if (setpriority(PRIO_PROCESS, tid, ARCHIVER_NICE) != 0)
+        wlog("Could not lower log archiver cpu priority: {}", strerror(errno));
+    int32_t ioprio = (ARCHIVER_IOPRIO_CLASS_IDLE << ARCHIVER_IOPRIO_CLASS_SHIFT);
+    if (syscall(SYS_ioprio_set, ARCHIVER_IOPRIO_WHO_PROCESS, tid, ioprio) != 0)
+        wlog("Could not lower log archiver io priority: {}", strerror(errno));
+
+    // The first scan waits a period so the loggers have claimed today's files by then
+    pthread_mutex_lock(&m_lock);
+    while (m_running)
+    {
+        if (!m_kicked)
+        {
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            ts.tv_sec += m_cfg.scan_period_s;
+            pthread_cond_timedwait(&m_cond, &m_lock, &ts);
+            if (!m_running)
+                break;
+        }
+        m_kicked = false;
+
+        pthread_mutex_unlock(&m_lock);
+        if (!m_paused)
+            _scan();
+        pthread_mutex_lock(&m_lock);
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+void * Log_Archiver::thread_exec(void * _this)
+{
+    Log_Archiver * archiver = static_cast<Log_Archiver *>(_this);
+    archiver->_exec();
+    return nullptr;
+}
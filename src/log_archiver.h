@@ -0,0 +1,130 @@
+#pragma once
+
+#include <pthread.h>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <atomic>
+
+#define DEFAULT_LOG_MAX_FILE_SIZE_KB 16384
+#define DEFAULT_LOG_DISK_BUDGET_MB 1024
+#define DEFAULT_LOG_SCAN_PERIOD_S 60
+#define LOG_ARCHIVE_EXTENSION ".gz"
+#define LOG_ARCHIVE_CHUNK_SIZE 65536
+
+class Config_File;
+
+/// How log files are rotated and what happens to them afterwards
+struct Log_Archive_Config
+{
+    Log_Archive_Config();
+
+    // A log file is closed and the next part started once it reaches this size - 0 for no limit (files still roll
+    // over every day)
+    uint32_t max_file_size_kb;
+
+    // Gzip rotated files
+    bool compress;
+
+    // Total size of every log file (rotated or not) in the watched dirs - the oldest rotated files are deleted to stay
+    // under it. 0 for no limit
+    uint32_t disk_budget_mb;
+
+    // Rotated files older than this are deleted - 0 keeps them until the budget needs the space
+    uint32_t max_age_days;
+
+    // How often the watched dirs are checked - rotating a file also triggers a check
+    uint32_t scan_period_s;
+};
+
+/// Fill acfg from the json object name (with keys max_file_size_kb, compress, disk_budget_mb, max_age_days,
+/// scan_period_s) - keys not present are left as is
+bool fill_log_archive_config_if_found(Config_File * cfg, const std::string & name, Log_Archive_Config * acfg);
+
+/// Name of part of a log file - part 1 is base + ext, the rest base + " part N" + ext
+std::string log_part_fname(const std::string & base, uint32_t part, const std::string & ext);
+
+class Log_Archiver;
+
+/// Find the first part of base/ext from first_part on that can still be appended to - it hasn't been compressed and is
+/// under max_size bytes (0 for no limit) - and claim it as owner's active file so the archiver leaves it alone. Returns
+/// the part and sets fname to its name. archiver can be null.
+uint32_t claim_log_part(Log_Archiver * archiver,
+                        const void * owner,
+                        const std::string & base,
+                        const std::string & ext,
+                        uint32_t first_part,
+                        uint64_t max_size,
+                        std::string * fname);
+
+/// Looks after rotated log files on a low priority (nice and idle io class) thread - gzips them and deletes the oldest
+/// to keep within the age and disk budgets. Files in the watched dirs that start with a watched prefix are the
+/// archiver's to manage, except for the ones an owner (a logger, the status log sink) has claimed as the file it is
+/// writing. Claiming a file waits for the archiver to finish with it if it was part way through, so once claimed a
+/// file is either untouched or already compressed.
+class Log_Archiver
+{
+  public:
+    Log_Archiver();
+    ~Log_Archiver();
+
+    bool start(const Log_Archive_Config & cfg);
+
+    void stop();
+
+    bool running();
+
+    const Log_Archive_Config & config() const;
+
+    /// Manage the files in dir whose names start with prefix - safe from any thread
+    void watch(const std::string & dir, const std::string & prefix);
+
+    /// Set owner's active file - an empty fname releases it, letting the archiver have it on its next scan. Safe from
+    /// any thread.
+    void set_active(const void * owner, const std::string & fname);
+
+    /// Check the watched dirs now rather than waiting for the scan period
+    void kick();
+
+    /// Stop touching files (ie while unmounting a drive) - returns once anything in progress is abandoned
+    void pause();
+
+    void resume();
+
+  private:
+    struct File_Info
+    {
+        std::string path;
+        uint64_t size;
+        time_t mtime;
+    };
+
+    void _scan();
+    void _list_files(std::vector<File_Info> * files);
+    bool _begin(const std::string & path);
+    void _end();
+    bool _compress(File_Info * file, std::string * err);
+    bool _remove(const File_Info & file);
+    bool _active(const std::string & path);
+    void _exec();
+
+    static void * thread_exec(void *);
+
+    Log_Archive_Config m_cfg;
+
+    // Everything below is shared with the owners' threads - guarded by m_lock
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_cond;
+    std::set<std::pair<std::string, std::string>> m_watched;
+    std::map<const void *, std::string> m_active;
+
+    // File the archiver thread is working on - claiming it waits for this to clear
+    std::string m_busy;
+    bool m_kicked;
+
+    std::atomic_bool m_running;
+    std::atomic_bool m_paused;
+    pthread_t m_thread;
+};
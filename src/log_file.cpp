@@ -0,0 +1,222 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "log_file.h"
+#include "config_file.h"
+#include "utility.h"
+#include "logger.h"
+
+bool fill_log_file_config_if_found(Config_File * cfg, const std::string & name, Log_File_Config * lcfg)
+{
+    nlohmann::json obj;
+    if (!cfg->fill_param_if_found(name, &obj))
+        return false;
+
+    try
+    {
+        fill_param_if_found(obj, "buffer_size", &lcfg->buffer_size);
+        fill_param_if_found(obj, "flush_period_ms", &lcfg->flush_period_ms);
+        fill_param_if_found(obj, "fsync_period_ms", &lcfg->fsync_period_ms);
+    }
+    catch (nlohmann::detail::exception & e)
+    {
+        elog("Error for {} - using buffer_size {} flush_period_ms {} fsync_period_ms {}",
+             name,
+             lcfg->buffer_size,
+             lcfg->flush_period_ms,
+             lcfg->fsync_period_ms);
+        return false;
+    }
+    return true;
+}
+
+Log_File::Log_File(const Log_File_Config & cfg)
+    : m_fd(-1), m_fname(), m_dev(0), m_ino(0), m_cfg(cfg), m_buffer(), m_disk_size(0), m_first_buffered_ms(0), m_last_sync_ms(0), m_sync_pending(false)
+{
+    m_buffer.reserve(m_cfg.buffer_size);
+}
+
+Log_File::~Log_File()
+{
+    close();
+}
+
+bool Log_File::open(const std::string & fname, bool * created)
+{
+    close();
+    m_fd = ::open(fname.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (m_fd == -1)
+        return false;
+
+    struct stat st;
+    fstat(m_fd, &st);
+    m_dev = st.st_dev;
+    m_ino = st.st_ino;
+    m_fname = fname;
+    m_disk_size = st.st_size;
+    m_last_sync_ms = util::monotonic_ms();
+    if (created)
+        *created = (st.st_size == 0);
+
+    // Anything left over from a failed write goes here
+    if (!m_buffer.empty())
+        flush();
+    return true;
+}
+
+void Log_File::close()
+{
+    if (m_fd == -1)
+        return;
+    sync();
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+bool Log_File::is_open() const
+{
+    return m_fd != -1;
+}
+
+const std::string & Log_File::fname() const
+{
+    return m_fname;
+}
+
+uint64_t Log_File::size() const
+{
+    return m_disk_size + m_buffer.size();
+}
+
+bool Log_File::write(const char * data, uint32_t size)
+{
+    if (m_buffer.empty())
+        m_first_buffered_ms = util::monotonic_ms();
+    m_buffer.append(data, size);
+    if (m_buffer.size() >= m_cfg.buffer_size)
+        return flush();
+    return true;
+}
+
+bool Log_File::write_line(const std::string & line)
+{
+    if (m_buffer.empty())
+        m_first_buffered_ms = util::monotonic_ms();
+    m_buffer.append(line);
+    m_buffer.push_back('\n');
+    if (m_buffer.size() >= m_cfg.buffer_size)
+        return flush();
+    return true;
+}
+
+bool Log_File::flush()
+{
+    if (m_buffer.empty())
+        return true;
+    if (m_fd == -1)
+        return false;
+
+    size_t written = 0;
+    while (written < m_buffer.size())
+    {
+        ssize_t cnt = ::write(m_fd, m_buffer.data() + written, m_buffer.size() - written);
+        if (cnt < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            // Keep whatever didn't make it for the next file opened
+            wlog("Could not write to {}: {} - closing it with {} bytes still buffered", m_fname, strerror(errno), m_buffer.size() - written);
+            m_buffer.erase(0, written);
+            ::close(m_fd);
+            m_fd = -1;
+            return false;
+        }
+        written += cnt;
+        m_disk_size += cnt;
+    }
+    m_buffer.clear();
+    m_sync_pending = true;
+
+    if (m_cfg.fsync_period_ms == 0)
+        return sync();
+    return true;
+}
+
+bool Log_File::sync()
+{
+    if (!flush())
+        return false;
+    if (m_sync_pending)
+    {
+        m_sync_pending = false;
+        m_last_sync_ms = util::monotonic_ms();
+        if (fsync(m_fd) != 0)
+        {
+            wlog("Could not fsync {}: {}", m_fname, strerror(errno));
+            return false;
+        }
+    }
+    return true;
+}
+
+void Log_File::update()
+{
+    if (m_fd == -1)
+        return;
+
+    double now = util::monotonic_ms();
+    if (!m_buffer.empty() && (now - m_first_buffered_ms) >= m_cfg.flush_period_ms)
+        flush();
+    if (m_fd != -1 && m_sync_pending && (now - m_last_sync_ms) >= m_cfg.fsync_period_ms)
+        sync();
+}
+
+double Log_File::ms_until_update() const
+{
+    if (m_fd == -1)
+        return -1;
+
+    double now = util::monotonic_ms();
+    bool due = false;
+    double ret = 0;
+    if (!m_buffer.empty())
+    {
+        ret = m_first_buffered_ms + m_cfg.flush_period_ms - now;
+        due = true;
+    }
+    if (m_sync_pending)
+    {
+        double sync_in = m_last_sync_ms + m_cfg.fsync_period_ms - now;
+        if (!due || sync_in < ret)
+            ret = sync_in;
+        due = true;
+    }
+    if (!due)
+        return -1;
+    return (ret < 0) ? 0 : ret;
+}
+
+bool Log_File::stale() const
+{
+    if (m_fd == -1)
+        return false;
+    struct stat st;
+    if (stat(m_fname.c_str(), &st) != 0)
+        return true;
+    return (st.st_dev != m_dev || st.st_ino != m_ino);
+}
+
+void Log_File::set_config(const Log_File_Config & cfg)
+{
+    m_cfg = cfg;
+    m_buffer.reserve(m_cfg.buffer_size);
+}
+
+const Log_File_Config & Log_File::config() const
+{
+    return m_cfg;
+}
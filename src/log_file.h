@@ -0,0 +1,101 @@
+#pragma once
+
+#include <sys/types.h>
+#include <inttypes.h>
+#include <string>
+
+#define DEFAULT_LOG_FILE_BUFFER_SIZE 16384
+#define DEFAULT_LOG_FILE_FLUSH_PERIOD_MS 1000
+#define DEFAULT_LOG_FILE_FSYNC_PERIOD_MS 10000
+
+class Config_File;
+
+/// When a Log_File pushes its buffer to the OS and when it asks the OS to push it to the disk
+struct Log_File_Config
+{
+    Log_File_Config(uint32_t buffer_size_ = DEFAULT_LOG_FILE_BUFFER_SIZE,
+                    uint32_t flush_period_ms_ = DEFAULT_LOG_FILE_FLUSH_PERIOD_MS,
+                    uint32_t fsync_period_ms_ = DEFAULT_LOG_FILE_FSYNC_PERIOD_MS)
+        : buffer_size(buffer_size_), flush_period_ms(flush_period_ms_), fsync_period_ms(fsync_period_ms_)
+    {}
+
+    // Flush once this many bytes are buffered
+    uint32_t buffer_size;
+
+    // Flush data that has been buffered this long
+    uint32_t flush_period_ms;
+
+    // fsync flushed data this long after the last fsync - 0 means fsync on every flush
+    uint32_t fsync_period_ms;
+};
+
+/// Fill lcfg from the json object name (with keys buffer_size, flush_period_ms, fsync_period_ms) - keys not
+/// present are left as is
+bool fill_log_file_config_if_found(Config_File * cfg, const std::string & name, Log_File_Config * lcfg);
+
+/// Append only file that stays open and buffers writes in memory. The buffer goes to the OS when it fills up or the
+/// oldest buffered data gets older than the flush period, and is fsynced on its own (longer) period. If a write
+/// fails the file is closed but the buffered data is kept, so it lands in whatever file is opened next.
+class Log_File
+{
+  public:
+    Log_File(const Log_File_Config & cfg = Log_File_Config());
+
+    ~Log_File();
+
+    /// Open fname for appending, closing any other file first - created is set if the file is new (or empty)
+    bool open(const std::string & fname, bool * created = nullptr);
+
+    /// Flush, fsync and close
+    void close();
+
+    bool is_open() const;
+
+    const std::string & fname() const;
+
+    /// Size the file will be once everything buffered is written
+    uint64_t size() const;
+
+    /// Buffer size bytes - returns false if the data couldn't be written out when the buffer filled up
+    bool write(const char * data, uint32_t size);
+
+    bool write_line(const std::string & line);
+
+    /// Write the buffer to the file
+    bool flush();
+
+    /// Flush and fsync
+    bool sync();
+
+    /// Flush and fsync if their periods are up - call regularly
+    void update();
+
+    /// Time until update() next has something to do, or -1 if nothing is buffered or waiting on a fsync
+    double ms_until_update() const;
+
+    /// True if the path no longer refers to the file we have open - ie it was deleted or the drive it was on was
+    /// swapped out
+    bool stale() const;
+
+    void set_config(const Log_File_Config & cfg);
+
+    const Log_File_Config & config() const;
+
+  private:
+    Log_File(const Log_File &);
+    Log_File & operator=(const Log_File &);
+
+    int32_t m_fd;
+    std::string m_fname;
+    dev_t m_dev;
+    ino_t m_ino;
+
+    Log_File_Config m_cfg;
+    std::string m_buffer;
+    uint64_t m_disk_size;
+
+    // Monotonic times (ms) the oldest unflushed data was buffered and of the last fsync
+    double m_first_buffered_ms;
+    double m_last_sync_ms;
+    bool m_sync_pending;
+};
@@ -0,0 +1,144 @@
+#include <string.h>
+#include <stdio.h>
+#include <cmath>
+
+#include "log_format.h"
+
+const char * LOG_PARAM_NAMES[LP_COUNT] = {"ptt_status", "forward_power", "reverse_power", "vswr", "squelch_status", "agc", "line_level"};
+
+bool log_param_is_status(uint8_t param)
+{
+    return param == LP_PTT_STATUS || param == LP_SQUELCH_STATUS;
+}
+
+const char * ptt_cstr(uint8_t status)
+{
+    if (status == PTT_OFF)
+        return "Off";
+    else if (status == PTT_LOCAL)
+        return "Key(L)";
+    else if (status == PTT_REMOTE)
+        return "Key(R)";
+    else if (status == PTT_TEST_RF)
+        return "Key(T)";
+    else
+        return "Invalid";
+}
+
+const char * squelch_cstr(uint8_t status)
+{
+    if (status == SQUELCH_OPEN)
+        return "Open";
+    else if (status == SQUELCH_CLOSED)
+        return "Clsd";
+    else
+        return "Invalid";
+}
+
+std::string ptt_string(uint8_t status)
+{
+    return ptt_cstr(status);
+}
+
+std::string squelch_string(uint8_t status)
+{
+    return squelch_cstr(status);
+}
+
+std::string radio_type_string(const char * serial)
+{
+    if (strchr(serial, 'T'))
+        return TX_STR;
+    else if (strchr(serial, 'R'))
+        return RX_STR;
+    else
+        return NOT_READY_STR;
+}
+
+std::string radio_range_string(const char * serial)
+{
+    if (strchr(serial, 'U'))
+        return "UHF";
+    else if (strchr(serial, 'V'))
+        return "VHF";
+    else
+        return NOT_READY_STR;
+}
+
+Log_Columns::Log_Columns() : tx_columns(), tx_column_count(0), rx_columns(), rx_column_count(0), titles()
+{}
+
+const uint8_t * Log_Columns::for_serial(const char * serial, uint8_t * count) const
+{
+    if (strchr(serial, 'T'))
+    {
+        *count = tx_column_count;
+        return tx_columns;
+    }
+    else if (strchr(serial, 'R'))
+    {
+        *count = rx_column_count;
+        return rx_columns;
+    }
+    *count = 0;
+    return nullptr;
+}
+
+namespace csv
+{
+// Same rounding the header has always used
+static std::string num_to_str(double val, int prec)
+{
+    std::string str = std::to_string(std::round(val * pow(10, prec)) / pow(10, prec));
+    return str.substr(0, str.find('.') + prec + 1);
+}
+
+void append_radio_header(const Log_Columns & cols, const char * serial, float freq_mhz, std::string * first_row, std::string * second_row)
+{
+    uint8_t column_count = 0;
+    const uint8_t * columns = cols.for_serial(serial, &column_count);
+    for (uint8_t col = 0; col < column_count; ++col)
+    {
+        if (col == 0)
+            *first_row +=
+                num_to_str(freq_mhz, 3) + " " + radio_range_string(serial) + " " + radio_type_string(serial) + " (" + serial + ")";
+        first_row->push_back(',');
+        *second_row += cols.titles[columns[col]] + ",";
+    }
+}
+
+std::string finish_header(std::string * first_row, std::string * second_row)
+{
+    if (!first_row->empty())
+    {
+        first_row->pop_back();
+        *first_row = ",," + *first_row;
+    }
+    if (!second_row->empty())
+    {
+        second_row->pop_back();
+        *second_row = "Time (h:m:s), Elapsed (s)," + *second_row;
+    }
+    return *first_row + "\n" + *second_row;
+}
+
+void append_time(time_t wall_time, double elapsed_s, std::string * row)
+{
+    char buf[32];
+    tm ltm;
+    localtime_r(&wall_time, &ltm);
+    row->append(buf, snprintf(buf, sizeof(buf), "%d:%d:%d,%.2f", ltm.tm_hour, ltm.tm_min, ltm.tm_sec, elapsed_s));
+}
+
+void append_value(uint8_t param, float value, std::string * row)
+{
+    char buf[32];
+    row->push_back(',');
+    if (param == LP_PTT_STATUS)
+        row->append(ptt_cstr(uint8_t(value)));
+    else if (param == LP_SQUELCH_STATUS)
+        row->append(squelch_cstr(uint8_t(value)));
+    else
+        row->append(buf, snprintf(buf, sizeof(buf), "%.2f", value));
+}
+} // namespace csv
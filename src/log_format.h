@@ -0,0 +1,75 @@
+#pragma once
+
+#include <inttypes.h>
+#include <time.h>
+#include <string>
+
+// Everything in here is plain C++ with no spdlog so the tools (see tools/) can render logs exactly the way the monitor does
+
+const std::string RX_STR = "RX";
+const std::string TX_STR = "TX";
+const std::string NOT_READY_STR = "Not Initialized";
+
+const uint8_t PTT_OFF = 1;
+const uint8_t PTT_LOCAL = 2;
+const uint8_t PTT_REMOTE = 4;
+const uint8_t PTT_TEST_RF = 8;
+
+const uint8_t SQUELCH_CLOSED = 1;
+const uint8_t SQUELCH_OPEN = 2;
+
+/// Every radio parameter a logger can have a column for - tx params come first
+enum Log_Param
+{
+    LP_PTT_STATUS,
+    LP_FORWARD_POWER,
+    LP_REVERSE_POWER,
+    LP_VSWR,
+    LP_SQUELCH_STATUS,
+    LP_AGC,
+    LP_LINE_LEVEL,
+    LP_COUNT
+};
+
+/// Config key for each Log_Param
+extern const char * LOG_PARAM_NAMES[LP_COUNT];
+
+/// Status params hold one of the PTT_ or SQUELCH_ values - the rest are floats
+bool log_param_is_status(uint8_t param);
+
+const char * ptt_cstr(uint8_t status);
+const char * squelch_cstr(uint8_t status);
+std::string ptt_string(uint8_t status);
+std::string squelch_string(uint8_t status);
+std::string radio_type_string(const char * serial);
+std::string radio_range_string(const char * serial);
+
+/// Which params a logger has columns for, in order, for each radio type and what each column is titled
+struct Log_Columns
+{
+    Log_Columns();
+
+    /// The columns for a radio with serial - null (with count 0) if the serial is neither a TX or RX
+    const uint8_t * for_serial(const char * serial, uint8_t * count) const;
+
+    uint8_t tx_columns[LP_COUNT];
+    uint8_t tx_column_count;
+    uint8_t rx_columns[LP_COUNT];
+    uint8_t rx_column_count;
+    std::string titles[LP_COUNT];
+};
+
+namespace csv
+{
+/// Add a radio's columns to the two header rows
+void append_radio_header(const Log_Columns & cols, const char * serial, float freq_mhz, std::string * first_row, std::string * second_row);
+
+/// Put the time columns in front of the rows built by append_radio_header and join them
+std::string finish_header(std::string * first_row, std::string * second_row);
+
+/// The time columns that start every row
+void append_time(time_t wall_time, double elapsed_s, std::string * row);
+
+/// A comma followed by the value of param
+void append_value(uint8_t param, float value, std::string * row);
+} // namespace csv
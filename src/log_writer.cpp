@@ -0,0 +1,295 @@
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#include "log_writer.h"
+#include "utility.h"
+#include "logger.h"
+#include "main_control.h"
+#include "timer.h"
+
+Log_Writer::Log_Writer()
+    : m_records(),
+      m_samples(),
+      m_sample_scratch(),
+      m_active(),
+      m_running(false),
+      m_held(false),
+      m_written(0),
+      m_dropped(0),
+      m_wake_fd(-1),
+      m_thread(0),
+      m_drain_seq(0),
+      m_drained_seq(0)
+{
+    pthread_mutex_init(&m_drain_lock, nullptr);
+    pthread_cond_init(&m_drain_cond, nullptr);
+}
+
+Log_Writer::~Log_Writer()
+{
+    stop();
+    pthread_cond_destroy(&m_drain_cond);
+    pthread_mutex_destroy(&m_drain_lock);
+}
+
+bool Log_Writer::start(uint32_t queue_size)
+{
+    if (m_running)
+        return false;
+
+    if (queue_size == 0)
+        queue_size = 1;
+
+    // Most rows hold a handful of radios - let the sample queue grow for big sites instead of sizing for them up front
+    m_records.resize(queue_size);
+    m_samples.resize(queue_size * LOG_WRITER_SAMPLES_PER_RECORD, queue_size * 256);
+    m_held = false;
+    m_written = 0;
+    m_dropped = 0;
+
+    m_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wake_fd == -1)
+    {
+        elog("Could not create event fd for csv writer: {}", strerror(errno));
+        return false;
+    }
+
+    m_running = true;
+    if (pthread_create(&m_thread, nullptr, Log_Writer::thread_exec, (void *)this) != 0)
+    {
+        elog("Could not create csv writer thread: {}", strerror(errno));
+        m_running = false;
+        m_thread = 0;
+        close(m_wake_fd);
+        m_wake_fd = -1;
+        return false;
+    }
+    ilog("Started csv writer with room for {} queued writes", queue_size);
+    return true;
+}
+
+void Log_Writer::stop()
+{
+    if (!m_running)
+        return;
+
+    // The writer finishes off whatever is queued before it exits
+    m_held = false;
+    m_running = false;
+    util::signal_event_fd(m_wake_fd);
+    pthread_join(m_thread, nullptr);
+    m_thread = 0;
+    close(m_wake_fd);
+    m_wake_fd = -1;
+    ilog("Stopped csv writer - {}", stats_string(stats()));
+}
+
+bool Log_Writer::running()
+{
+    return m_running;
+}
+
+bool Log_Writer::enqueue(Logger_Entry * logger, Log_Record::Type type, const std::vector<Radio_Sample> & samples)
+{
+    Log_Record rec(type, logger, samples.size());
+    rec.wall_ms = util::wall_ms();
+    rec.elapsed_s = edm.sys_timer()->elapsed() / 1000.0;
+    return _push(rec, &samples);
+}
+
+bool Log_Writer::enqueue_close(Logger_Entry * logger)
+{
+    Log_Record rec(Log_Record::Close, logger);
+    return _push_wait(rec);
+}
+
+bool Log_Writer::enqueue_recheck_dir(Logger_Entry * logger)
+{
+    Log_Record rec(Log_Record::Recheck_Dir, logger);
+    return _push_wait(rec);
+}
+
+bool Log_Writer::_push(Log_Record & rec, const std::vector<Radio_Sample> * samples)
+{
+    if (!m_running)
+    {
+        ++m_dropped;
+        return false;
+    }
+
+    // All or nothing - check there is room for both the samples and the record before pushing either
+    if (m_records.free_space() == 0 || m_samples.free_space() < rec.sample_count)
+    {
+        ++m_dropped;
+        return false;
+    }
+
+    if (samples && !samples->empty())
+        m_samples.push(samples->data(), samples->size());
+
+    // Samples go first so they are there by the time the writer sees the record
+    m_records.push(&rec, 1);
+    util::signal_event_fd(m_wake_fd);
+    return true;
+}
+
+bool Log_Writer::_push_wait(const Log_Record & rec)
+{
+    // Closes matter most when writes have stalled (ie the drive is being pulled) and a dropped one would leave the file
+    // open on it - so wait for room instead. Nothing is taken off the queue while held, so the hold has to go first
+    while (m_running && m_records.free_space() == 0)
+    {
+        if (m_held)
+        {
+            wlog("Csv writer queue is full while held - releasing the hold to get a file close through");
+            hold(false);
+        }
+        usleep(1000);
+    }
+    if (!m_running)
+    {
+        ++m_dropped;
+        return false;
+    }
+    m_records.push(&rec, 1);
+    util::signal_event_fd(m_wake_fd);
+    return true;
+}
+
+void Log_Writer::drain()
+{
+    if (!m_running)
+        return;
+
+    hold(false);
+    pthread_mutex_lock(&m_drain_lock);
+    uint32_t seq = ++m_drain_seq;
+    pthread_mutex_unlock(&m_drain_lock);
+
+    Log_Record rec(Log_Record::Drain);
+    rec.seq = seq;
+
+    // A drain can't be dropped - wait for room
+    if (!_push_wait(rec))
+        return;
+
+    pthread_mutex_lock(&m_drain_lock);
+    while (m_drained_seq != seq && m_running)
+        pthread_cond_wait(&m_drain_cond, &m_drain_lock);
+    pthread_mutex_unlock(&m_drain_lock);
+}
+
+void Log_Writer::hold(bool held)
+{
+    if (m_held == held)
+        return;
+    m_held = held;
+    if (!held)
+        util::signal_event_fd(m_wake_fd);
+}
+
+Log_Writer_Stats Log_Writer::stats()
+{
+    Log_Writer_Stats ret;
+    ret.queued = m_records.size();
+    ret.high_water = m_records.high_water();
+    ret.written = m_written;
+    ret.dropped = m_dropped;
+    return ret;
+}
+
+std::string Log_Writer::stats_string(const Log_Writer_Stats & stats)
+{
+    return "queued: " + std::to_string(stats.queued) + " (high water " + std::to_string(stats.high_water) +
+           ")  written: " + std::to_string(stats.written) + "  dropped: " + std::to_string(stats.dropped);
+}
+
+void Log_Writer::_process(const Log_Record & rec)
+{
+    if (rec.type == Log_Record::Drain)
+    {
+        m_active.clear();
+        pthread_mutex_lock(&m_drain_lock);
+        m_drained_seq = rec.seq;
+        pthread_cond_broadcast(&m_drain_cond);
+        pthread_mutex_unlock(&m_drain_lock);
+        return;
+    }
+
+    m_sample_scratch.resize(rec.sample_count);
+    if (rec.sample_count > 0)
+        m_samples.pop(m_sample_scratch.data(), rec.sample_count);
+
+    Logger_Entry * le = rec.logger;
+    if (rec.type == Log_Record::Close)
+    {
+        le->close_file();
+        return;
+    }
+    if (rec.type == Log_Record::Recheck_Dir)
+    {
+        if (le->in_backup_dir())
+            le->close_file();
+        return;
+    }
+
+    m_active.insert(le);
+    bool ok;
+    if (rec.type == Log_Record::Header)
+        ok = le->write_header_now(m_sample_scratch.data(), rec.sample_count, rec.wall_ms, rec.elapsed_s);
+    else
+        ok = le->write_row_now(m_sample_scratch.data(), rec.sample_count, rec.wall_ms, rec.elapsed_s);
+    if (ok)
+        ++m_written;
+}
+
+void Log_Writer::_exec()
+{
+    pollfd pfd = {};
+    pfd.fd = m_wake_fd;
+    pfd.events = POLLIN;
+
+    while (true)
+    {
+        Log_Record rec;
+        while (!m_held && m_records.pop(&rec, 1) == 1)
+            _process(rec);
+
+        if (!m_running)
+            break;
+
+        // Time based flushing/fsyncing for every file we have written to
+        double wait_ms = LOG_WRITER_MAX_WAIT_MS;
+        auto iter = m_active.begin();
+        while (iter != m_active.end())
+        {
+            (*iter)->update_file();
+            double file_ms = (*iter)->file->ms_until_update();
+            if (file_ms >= 0 && file_ms < wait_ms)
+                wait_ms = file_ms;
+            ++iter;
+        }
+
+        if (poll(&pfd, 1, int32_t(wait_ms) + 1) > 0)
+        {
+            uint64_t val;
+            ::read(m_wake_fd, &val, sizeof(val));
+        }
+    }
+
+    // Last chance for anything waiting on a drain
+    pthread_mutex_lock(&m_drain_lock);
+    m_drained_seq = m_drain_seq;
+    pthread_cond_broadcast(&m_drain_cond);
+    pthread_mutex_unlock(&m_drain_lock);
+}
+
+void * Log_Writer::thread_exec(void * _this)
+{
+    Log_Writer * writer = static_cast<Log_Writer *>(_this);
+    writer->_exec();
+    return nullptr;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <pthread.h>
+#include <time.h>
+#include <vector>
+#include <set>
+#include <atomic>
+
+#include "spsc_ring.h"
+#include "radio_telnet.h"
+
+#define DEFAULT_LOG_WRITER_QUEUE_SIZE 256
+#define LOG_WRITER_SAMPLES_PER_RECORD 8
+#define LOG_WRITER_MAX_WAIT_MS 1000
+
+/// One queued csv write - the radio samples it refers to are queued separately, in order, in the sample queue
+struct Log_Record
+{
+    enum Type
+    {
+        Header,
+        Row,
+        Close,
+        Recheck_Dir,
+        Drain
+    };
+
+    Log_Record(Type type_ = Row, Logger_Entry * logger_ = nullptr, uint32_t sample_count_ = 0)
+        : type(type_), logger(logger_), sample_count(sample_count_), wall_ms(0), elapsed_s(0), seq(0)
+    {}
+
+    Type type;
+    Logger_Entry * logger;
+    uint32_t sample_count;
+    int64_t wall_ms;
+    double elapsed_s;
+    uint32_t seq;
+};
+
+/// Counters for the writer queue - queued is the current depth
+struct Log_Writer_Stats
+{
+    Log_Writer_Stats() : queued(0), high_water(0), written(0), dropped(0)
+    {}
+
+    uint32_t queued;
+    uint32_t high_water;
+    uint64_t written;
+    uint64_t dropped;
+};
+
+/// Writes the loggers' csv files on its own thread. The main loop only pushes the loggers' compact radio snapshots on
+/// a lock free queue - formatting the rows and all the file io (flushing, fsyncing, reopening) is done
+/// by the writer. If the queue is full the record is dropped and counted rather than blocking the main loop.
+class Log_Writer
+{
+  public:
+    Log_Writer();
+    ~Log_Writer();
+
+    bool start(uint32_t queue_size = DEFAULT_LOG_WRITER_QUEUE_SIZE);
+
+    /// Write everything queued and stop the thread
+    void stop();
+
+    bool running();
+
+    /// Queue a header/row for logger with a snapshot of the radios - returns false if it had to be dropped
+    bool enqueue(Logger_Entry * logger, Log_Record::Type type, const std::vector<Radio_Sample> & samples);
+
+    /// Queue closing the logger's file - it is reopened on the next write. Never dropped for a full queue - it waits for
+    /// room, and only returns false once the writer is stopped
+    bool enqueue_close(Logger_Entry * logger);
+
+    /// Queue closing the logger's file if it had to fall back to the backup dir, so the next write tries its dir_path
+    /// again (ie once the drive is mounted) - waits for room like enqueue_close
+    bool enqueue_recheck_dir(Logger_Entry * logger);
+
+    /// Block until everything queued so far has been written - afterwards the writer has forgotten every logger, so
+    /// they can be changed or destroyed until they are next queued
+    void drain();
+
+    /// While held the writer leaves everything queued (ie while the drive the files are on is being swapped) - records
+    /// keep being queued, and dropped once the queue is full, until it is released. Draining releases the hold, and so
+    /// does a close that finds the queue full.
+    void hold(bool held);
+
+    Log_Writer_Stats stats();
+
+    static std::string stats_string(const Log_Writer_Stats & stats);
+
+  private:
+    bool _push(Log_Record & rec, const std::vector<Radio_Sample> * samples);
+    bool _push_wait(const Log_Record & rec);
+    void _process(const Log_Record & rec);
+    void _exec();
+
+    static void * thread_exec(void *);
+
+    // Main loop is the only producer and the writer thread the only consumer
+    Spsc_Ring<Log_Record> m_records;
+    Spsc_Ring<Radio_Sample> m_samples;
+
+    // Writer thread only
+    std::vector<Radio_Sample> m_sample_scratch;
+    std::set<Logger_Entry *> m_active;
+
+    std::atomic_bool m_running;
+    std::atomic_bool m_held;
+    std::atomic<uint64_t> m_written;
+    std::atomic<uint64_t> m_dropped;
+    int32_t m_wake_fd;
+    pthread_t m_thread;
+
+    // Drain handshake
+    pthread_mutex_t m_drain_lock;
+    pthread_cond_t m_drain_cond;
+    uint32_t m_drain_seq;
+    uint32_t m_drained_seq;
+};
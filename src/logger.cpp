@@ -1,12 +1,162 @@
-#include <spdlog/sinks/daily_file_sink.h>
+#include <spdlog/sinks/base_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/details/file_helper.h>
+#include <spdlog/async_logger.h>
+#include <spdlog/details/thread_pool.h>
 #include <list>
+#include <mutex>
 
 #include "utility.h"
 #include "logger.h"
 #include "main_control.h"
+#include "log_archiver.h"
+#include "config_file.h"
 
-Logger::Logger() : initialized(false)
+const std::string STATUS_LOG_BASE_NAME = "radio_monitor_";
+const std::string STATUS_LOG_EXTENSION = ".log";
+const std::string STATUS_LOG_PATTERN = "[%m/%d %X.%e TID:%t] [%s:%#] %^[%l]%$ %v";
+const std::string STATUS_LOG_OVERFLOW_BLOCK = "block";
+const std::string STATUS_LOG_OVERFLOW_DROP_OLDEST = "drop_oldest";
+
+Status_Log_Config::Status_Log_Config()
+    : async(true),
+      queue_size(DEFAULT_STATUS_LOG_QUEUE_SIZE),
+      block_when_full(true),
+      flush_period_s(DEFAULT_STATUS_LOG_FLUSH_PERIOD_S),
+      flush_level(spdlog::level::warn)
+{}
+
+bool fill_status_log_config_if_found(Config_File * cfg, const std::string & name, Status_Log_Config * lcfg)
+{
+    nlohmann::json obj;
+    if (!cfg->fill_param_if_found(name, &obj))
+        return false;
+
+    bool ret = true;
+    try
+    {
+        fill_param_if_found(obj, "async", &lcfg->async);
+        fill_param_if_found(obj, "queue_size", &lcfg->queue_size);
+        fill_param_if_found(obj, "flush_period_s", &lcfg->flush_period_s);
+
+        std::string overflow;
+        if (fill_param_if_found(obj, "overflow", &overflow))
+        {
+            if (overflow == STATUS_LOG_OVERFLOW_BLOCK)
+                lcfg->block_when_full = true;
+            else if (overflow == STATUS_LOG_OVERFLOW_DROP_OLDEST)
+                lcfg->block_when_full = false;
+            else
+            {
+                elog("Unknown {} overflow {} - should be {} or {}", name, overflow, STATUS_LOG_OVERFLOW_BLOCK, STATUS_LOG_OVERFLOW_DROP_OLDEST);
+                ret = false;
+            }
+        }
+
+        std::string level;
+        if (fill_param_if_found(obj, "flush_level", &level))
+        {
+            spdlog::level::level_enum lvl = spdlog::level::from_str(level);
+            if (lvl != spdlog::level::off || level == "off")
+                lcfg->flush_level = lvl;
+            else
+            {
+                elog("Unknown {} flush_level {}", name, level);
+                ret = false;
+            }
+        }
+    }
+    catch (nlohmann::detail::exception & e)
+    {
+        elog("Error for {} - using async {} queue_size {} overflow {} flush_period_s {} flush_level {}",
+             name,
+             lcfg->async,
+             lcfg->queue_size,
+             lcfg->block_when_full ? STATUS_LOG_OVERFLOW_BLOCK : STATUS_LOG_OVERFLOW_DROP_OLDEST,
+             lcfg->flush_period_s,
+             spdlog::level::to_string_view(lcfg->flush_level));
+        return false;
+    }
+
+    if (lcfg->queue_size == 0)
+    {
+        wlog("{} queue_size can't be 0 - using {}", name, DEFAULT_STATUS_LOG_QUEUE_SIZE);
+        lcfg->queue_size = DEFAULT_STATUS_LOG_QUEUE_SIZE;
+        ret = false;
+    }
+    return ret;
+}
+
+/// Status log file named by date (radio_monitor_YYYY-MM-DD.log) like spdlog's daily sink, that also moves on to a new
+/// part of the day's log when the file reaches the max size. Finished files are left for the log archiver.
+class Status_File_Sink : public spdlog::sinks::base_sink<std::mutex>
+{
+  public:
+    Status_File_Sink(const std::string & dir) : m_dir(dir), m_part(1), m_size(0), m_max_size(0), m_day_end(0), m_archiver(nullptr)
+    {
+        _open(time(nullptr));
+    }
+
+    void set_rotation(uint64_t max_size, Log_Archiver * archiver)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (m_archiver && m_archiver != archiver)
+            m_archiver->set_active(this, std::string());
+        m_max_size = max_size;
+        m_archiver = archiver;
+        if (m_archiver)
+            m_archiver->set_active(this, m_file.filename());
+    }
+
+  protected:
+    void sink_it_(const spdlog::details::log_msg & msg) override
+    {
+        time_t now = spdlog::log_clock::to_time_t(msg.time);
+        if (now >= m_day_end || (m_max_size > 0 && m_size >= m_max_size))
+            _open(now);
+
+        spdlog::memory_buf_t formatted;
+        formatter_->format(msg, formatted);
+        m_file.write(formatted);
+        m_size += formatted.size();
+    }
+
+    void flush_() override
+    {
+        m_file.flush();
+    }
+
+  private:
+    void _open(time_t now)
+    {
+        tm ltm;
+        localtime_r(&now, &ltm);
+        char date[16];
+        strftime(date, sizeof(date), "%Y-%m-%d", &ltm);
+
+        // Same as the csv logs - a new day starts from part 1 and a full part moves on to the next
+        if (now >= m_day_end)
+            m_part = 1;
+        else
+            ++m_part;
+
+        std::string fname;
+        m_part = claim_log_part(m_archiver, this, m_dir + "/" + STATUS_LOG_BASE_NAME + date, STATUS_LOG_EXTENSION, m_part, m_max_size, &fname);
+        m_file.open(fname, false);
+        m_size = std::max(util::file_size(fname), int64_t(0));
+        m_day_end = util::next_local_midnight(now);
+    }
+
+    std::string m_dir;
+    spdlog::details::file_helper m_file;
+    uint32_t m_part;
+    uint64_t m_size;
+    uint64_t m_max_size;
+    time_t m_day_end;
+    Log_Archiver * m_archiver;
+};
+
+Logger::Logger() : initialized(false), last_dropped_(0), next_drop_check_ms_(0)
 {}
 
 Logger::~Logger()
@@ -17,34 +167,127 @@ void Logger::initialize()
     if (!initialized)
     {
         std::string home_dir = util::get_home_dir({"ubuntu", "dprandle", "root"});
-        std::string local_dir = home_dir + "/status_logs";
-        std::string log_fname("/radio_monitor.log");
+        log_dir_ = home_dir + "/status_logs";
 
         initialized = true;
-        std::vector<spdlog::sink_ptr> loggers;
 
         auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
         console_sink->set_level(spdlog::level::debug);
-        loggers.push_back(console_sink);
+        sinks_.push_back(console_sink);
 
-        if (util::path_exists(local_dir) || (mkdir(local_dir.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) == 0))
+        if (util::path_exists(log_dir_) || (mkdir(log_dir_.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) == 0))
         {
-            auto file_sink_local = std::make_shared<spdlog::sinks::daily_file_sink_mt>(local_dir + log_fname, 0, 0);
-            file_sink_local->set_level(spdlog::level::info);
-            loggers.push_back(file_sink_local);
+            file_sink_ = std::make_shared<Status_File_Sink>(log_dir_);
+            file_sink_->set_level(spdlog::level::info);
+            sinks_.push_back(file_sink_);
         }
 
-        spdlog::flush_every(std::chrono::seconds(3));
-        spdlog::flush_on(spdlog::level::info);
+        // Flush on everything until the config says otherwise so nothing from startup is lost
+        spdlog::flush_every(std::chrono::seconds(cfg_.flush_period_s));
+        _set_logger(std::make_shared<spdlog::logger>("multi_sink", sinks_.begin(), sinks_.end()));
+        logger_->flush_on(spdlog::level::info);
+    }
+}
+
+void Logger::set_rotation(uint64_t max_file_size, Log_Archiver * archiver)
+{
+    if (!file_sink_)
+        return;
+    file_sink_->set_rotation(max_file_size, archiver);
+    if (archiver)
+        archiver->watch(log_dir_, STATUS_LOG_BASE_NAME);
+}
+
+void Logger::configure(const Status_Log_Config & lcfg)
+{
+    if (!initialized)
+        return;
 
-        logger_ = std::make_shared<spdlog::logger>("multi_sink", loggers.begin(), loggers.end());
-        logger_->set_level(spdlog::level::trace);
-        logger_->set_pattern("[%m/%d %X.%e TID:%t] [%s:%#] %^[%l]%$ %v");
-        spdlog::set_default_logger(logger_);
+    if (lcfg.async != bool(pool_) || (pool_ && (lcfg.queue_size != cfg_.queue_size || lcfg.block_when_full != cfg_.block_when_full)))
+    {
+        // The old pool's thread writes out whatever is still queued before it exits
+        std::shared_ptr<spdlog::details::thread_pool> old_pool = pool_;
+        pool_.reset();
+        if (lcfg.async)
+        {
+            pool_ = std::make_shared<spdlog::details::thread_pool>(lcfg.queue_size, 1);
+            auto policy = lcfg.block_when_full ? spdlog::async_overflow_policy::block : spdlog::async_overflow_policy::overrun_oldest;
+            _set_logger(std::make_shared<spdlog::async_logger>("multi_sink", sinks_.begin(), sinks_.end(), pool_, policy));
+        }
+        else
+        {
+            _set_logger(std::make_shared<spdlog::logger>("multi_sink", sinks_.begin(), sinks_.end()));
+        }
+        old_pool.reset();
+        last_dropped_ = 0;
     }
+
+    if (lcfg.flush_period_s != cfg_.flush_period_s && lcfg.flush_period_s > 0)
+        spdlog::flush_every(std::chrono::seconds(lcfg.flush_period_s));
+    logger_->flush_on(lcfg.flush_level);
+    cfg_ = lcfg;
+
+    ilog("Status log is {} (queue_size {} overflow {}) - flushing every {} s and on {} and up",
+         pool_ ? "async" : "sync",
+         cfg_.queue_size,
+         cfg_.block_when_full ? STATUS_LOG_OVERFLOW_BLOCK : STATUS_LOG_OVERFLOW_DROP_OLDEST,
+         cfg_.flush_period_s,
+         spdlog::level::to_string_view(cfg_.flush_level));
+}
+
+void Logger::update()
+{
+    if (!pool_)
+        return;
+
+    double now = util::monotonic_ms();
+    if (now < next_drop_check_ms_)
+        return;
+    next_drop_check_ms_ = now + STATUS_LOG_DROP_CHECK_PERIOD_MS;
+
+    uint64_t dropped = pool_->overrun_counter();
+    if (dropped > last_dropped_)
+    {
+        wlog("Status log queue full - dropped {} messages in the last {} s", dropped - last_dropped_, STATUS_LOG_DROP_CHECK_PERIOD_MS / 1000);
+        last_dropped_ = dropped;
+    }
+}
+
+Status_Log_Stats Logger::stats()
+{
+    Status_Log_Stats ret{};
+    if (pool_)
+    {
+        ret.queued = pool_->queue_size();
+        ret.dropped = pool_->overrun_counter();
+    }
+    return ret;
+}
+
+std::string Logger::stats_string(const Status_Log_Stats & stats)
+{
+    return "queued: " + std::to_string(stats.queued) + "  dropped: " + std::to_string(stats.dropped);
 }
 
 void Logger::terminate()
 {
+    if (pool_)
+    {
+        ilog("Stopping async status log - {}", stats_string(stats()));
+        std::shared_ptr<spdlog::details::thread_pool> old_pool = pool_;
+        pool_.reset();
+        _set_logger(std::make_shared<spdlog::logger>("multi_sink", sinks_.begin(), sinks_.end()));
+        old_pool.reset();
+    }
     logger_->flush();
+}
+
+void Logger::_set_logger(const std::shared_ptr<spdlog::logger> & logger)
+{
+    logger->set_level(spdlog::level::trace);
+    logger->set_pattern(STATUS_LOG_PATTERN);
+    if (logger_)
+        logger->flush_on(logger_->flush_level());
+    logger_ = logger;
+    spdlog::set_default_logger(logger_);
 }
\ No newline at end of file
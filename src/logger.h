@@ -14,6 +14,54 @@ namespace spdlog
 class logger;
 }
 
+#define DEFAULT_STATUS_LOG_QUEUE_SIZE 8192
+#define DEFAULT_STATUS_LOG_FLUSH_PERIOD_S 3
+#define STATUS_LOG_DROP_CHECK_PERIOD_MS 10000
+
+namespace spdlog
+{
+namespace details
+{
+class thread_pool;
+}
+}
+
+class Status_File_Sink;
+class Log_Archiver;
+class Config_File;
+
+/// How status messages get to the console and status log file
+struct Status_Log_Config
+{
+    Status_Log_Config();
+
+    // Format and write messages on a background thread rather than in the ilog/wlog call
+    bool async;
+
+    // Messages that can be waiting for the background thread
+    uint32_t queue_size;
+
+    // With the queue full, wait for room (true) or drop the oldest waiting message (false)
+    bool block_when_full;
+
+    // Buffered messages are flushed to the file this often, and straight away for messages at flush_level or above
+    uint32_t flush_period_s;
+    spdlog::level::level_enum flush_level;
+};
+
+/// Fill lcfg from the json object name (with keys async, queue_size, overflow ("block" or "drop_oldest"),
+/// flush_period_s, and flush_level) - keys not present are left as is
+bool fill_status_log_config_if_found(Config_File * cfg, const std::string & name, Status_Log_Config * lcfg);
+
+struct Status_Log_Stats
+{
+    // Messages waiting for the background thread right now
+    uint64_t queued;
+
+    // Total messages dropped because the queue was full
+    uint64_t dropped;
+};
+
 class Logger
 {
   public:
@@ -22,9 +70,35 @@ class Logger
 
     void initialize();
 
+    /// Start a new part of the status log once it reaches max_file_size bytes (0 for only starting a new file every
+    /// day), and have archiver (if not null) watch the status log dir and leave the file being written alone
+    void set_rotation(uint64_t max_file_size, Log_Archiver * archiver);
+
+    /// Switch between writing messages in the calling thread and handing them to a background thread, and set how
+    /// often the status log is flushed. Messages are written synchronously from initialize until this is called.
+    void configure(const Status_Log_Config & lcfg);
+
+    /// Warn about messages dropped since the last check - call from the main loop
+    void update();
+
+    /// Both zero when logging synchronously
+    Status_Log_Stats stats();
+
+    static std::string stats_string(const Status_Log_Stats & stats);
+
+    /// Write out anything still queued and go back to logging synchronously
     void terminate();
 
   private:
+    void _set_logger(const std::shared_ptr<spdlog::logger> & logger);
+
     bool initialized;
+    std::string log_dir_;
+    std::vector<spdlog::sink_ptr> sinks_;
+    Status_Log_Config cfg_;
+    std::shared_ptr<spdlog::details::thread_pool> pool_;
+    uint64_t last_dropped_;
+    double next_drop_check_ms_;
     std::shared_ptr<spdlog::logger> logger_;
+    std::shared_ptr<Status_File_Sink> file_sink_;
 };
\ No newline at end of file
@@ -1,6 +1,10 @@
 #include <unistd.h>
 #include <vector>
 #include <sys/mount.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
 
 #include "utility.h"
 #include "main_control.h"
@@ -8,21 +12,45 @@
 #include "timer.h"
 #include "logger.h"
 #include "config_file.h"
+#include "log_archiver.h"
+#include "drive_worker.h"
 
 const int32_t mount_unmount_wait_ms = 4000;
 
-Main_Control::Main_Control() : m_running(false), m_systimer(new Timer()), logger_(new Logger)
+Main_Control::Main_Control()
+    : m_running(false),
+      m_systimer(new Timer()),
+      logger_(new Logger),
+      m_archiver(new Log_Archiver),
+      m_drive_worker(new Drive_Worker),
+      m_epoll_fd(epoll_create1(EPOLL_CLOEXEC)),
+      m_timer_fd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+      m_wake_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      m_next_update_ms(0),
+      m_drive_fd(-1),
+      m_drive_watched(false),
+      m_drive_present(false),
+      m_drive_poll_ms(DEFAULT_USB_DRIVE_POLL_PERIOD_MS),
+      m_next_drive_poll_ms(0)
 {
     util::zero_buf(systems_, MAX_SYSTEM_COUNT);
+    watch_fd(m_timer_fd, EPOLLIN);
+    watch_fd(m_wake_fd, EPOLLIN);
 }
 
 Main_Control::~Main_Control()
 {
+    stop_usb_drive_watch();
+    close(m_wake_fd);
+    close(m_timer_fd);
+    close(m_epoll_fd);
     delete m_systimer;
     uint32_t len = util::buf_len(systems_);
     for (int i = 0; i < len; ++i)
         delete systems_[i];
     util::zero_buf(systems_, MAX_SYSTEM_COUNT);
+    delete m_drive_worker;
+    delete m_archiver;
     delete logger_;
 }
 
@@ -61,7 +89,86 @@ void Main_Control::restart_updated(const char * exe_path, const char * const par
 
 bool Main_Control::usb_drive_detected()
 {
-    return util::path_exists("/dev/sda");
+    if (!m_drive_watched)
+        return util::path_exists(USB_DRIVE_DEV_DIR + "/" + USB_DRIVE_DEV_NAME);
+    return m_drive_present;
+}
+
+void Main_Control::start_usb_drive_watch(uint32_t poll_ms)
+{
+    stop_usb_drive_watch();
+    m_drive_poll_ms = poll_ms;
+
+    m_drive_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_drive_fd == -1)
+    {
+        wlog("Could not create inotify fd for {}: {} - polling for the usb drive every {} ms", USB_DRIVE_DEV_DIR, strerror(errno), m_drive_poll_ms);
+    }
+    else if (inotify_add_watch(m_drive_fd, USB_DRIVE_DEV_DIR.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO) == -1 ||
+             !watch_fd(m_drive_fd, EPOLLIN))
+    {
+        wlog("Could not watch {}: {} - polling for the usb drive every {} ms", USB_DRIVE_DEV_DIR, strerror(errno), m_drive_poll_ms);
+        close(m_drive_fd);
+        m_drive_fd = -1;
+    }
+    else
+    {
+        ilog("Watching {} for usb drive {}", USB_DRIVE_DEV_DIR, USB_DRIVE_DEV_NAME);
+    }
+
+    // Check after adding the watch so a drive plugged in between the two isn't missed
+    m_drive_present = util::path_exists(USB_DRIVE_DEV_DIR + "/" + USB_DRIVE_DEV_NAME);
+    m_next_drive_poll_ms = util::monotonic_ms() + m_drive_poll_ms;
+    m_drive_watched = true;
+}
+
+void Main_Control::stop_usb_drive_watch()
+{
+    if (m_drive_fd != -1)
+    {
+        unwatch_fd(m_drive_fd);
+        close(m_drive_fd);
+        m_drive_fd = -1;
+    }
+    m_drive_watched = false;
+}
+
+void Main_Control::_update_usb_drive_watch()
+{
+    if (!m_drive_watched)
+        return;
+
+    bool check = false;
+    if (m_drive_fd != -1)
+    {
+        // Only events for the drive's node matter, but an overflowed queue means some might have been missed
+        alignas(inotify_event) char buf[4096];
+        ssize_t len;
+        while ((len = ::read(m_drive_fd, buf, sizeof(buf))) > 0)
+        {
+            ssize_t offset = 0;
+            while (offset < len)
+            {
+                inotify_event * ev = (inotify_event *)(buf + offset);
+                if ((ev->mask & IN_Q_OVERFLOW) || (ev->len > 0 && USB_DRIVE_DEV_NAME == ev->name))
+                    check = true;
+                offset += sizeof(inotify_event) + ev->len;
+            }
+        }
+    }
+    else
+    {
+        double now = util::monotonic_ms();
+        if (now >= m_next_drive_poll_ms)
+        {
+            check = true;
+            m_next_drive_poll_ms = now + m_drive_poll_ms;
+        }
+        schedule_update(m_next_drive_poll_ms - now);
+    }
+
+    if (check)
+        m_drive_present = util::path_exists(USB_DRIVE_DEV_DIR + "/" + USB_DRIVE_DEV_NAME);
 }
 
 const std::string & Main_Control::get_config_fname()
@@ -84,6 +191,8 @@ void Main_Control::release()
 
 void Main_Control::unmount_drive()
 {
+    // Anything the archiver has open on the drive would keep it busy
+    m_archiver->pause();
     errno = 0;
     if (umount(USB_DRIVE_MNT_DIR.c_str()) == 0)
     {
@@ -94,21 +203,103 @@ void Main_Control::unmount_drive()
         ilog("Did not unmount {}: {}", USB_DRIVE_MNT_DIR, strerror(errno));
     }
     rmdir(USB_DRIVE_MNT_DIR.c_str());
+    m_archiver->resume();
 }
 
 void Main_Control::update()
 {
     m_systimer->update();
+    logger_->update();
+    m_next_update_ms = MAIN_LOOP_MAX_WAIT_MS;
+    _update_usb_drive_watch();
+    m_drive_worker->update();
     uint32_t len = util::buf_len(systems_);
     for (int i = 0; i < len; ++i)
         systems_[i]->update();
 }
 
+void Main_Control::wake()
+{
+    util::signal_event_fd(m_wake_fd);
+}
+
+int32_t Main_Control::wake_fd()
+{
+    return m_wake_fd;
+}
+
+void Main_Control::schedule_update(double ms)
+{
+    if (ms < m_next_update_ms)
+        m_next_update_ms = ms;
+}
+
+bool Main_Control::watch_fd(int32_t fd, uint32_t events)
+{
+    epoll_event ev = {};
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+    {
+        elog("Could not add fd {} to main loop: {}", fd, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void Main_Control::unwatch_fd(int32_t fd)
+{
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void Main_Control::_wait_for_events()
+{
+    if (m_next_update_ms <= 0)
+        return;
+
+    // Arm the timer for the earliest deadline asked for since the last update
+    itimerspec its = {};
+    its.it_value.tv_sec = time_t(m_next_update_ms / 1000.0);
+    its.it_value.tv_nsec = long((m_next_update_ms - its.it_value.tv_sec * 1000.0) * 1000000.0);
+    if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+        its.it_value.tv_nsec = 1;
+    timerfd_settime(m_timer_fd, 0, &its, nullptr);
+
+    epoll_event events[MAIN_LOOP_MAX_EVENTS];
+    int32_t cnt = epoll_wait(m_epoll_fd, events, MAIN_LOOP_MAX_EVENTS, -1);
+    if (cnt < 0 && errno != EINTR)
+    {
+        elog("Main loop epoll_wait failed: {} - falling back to timed wait", strerror(errno));
+        usleep(useconds_t(m_next_update_ms * 1000.0));
+        return;
+    }
+
+    // Drain our own fds - any watched fds are left for their subsystem to handle
+    for (int32_t i = 0; i < cnt; ++i)
+    {
+        if (events[i].data.fd == m_timer_fd || events[i].data.fd == m_wake_fd)
+        {
+            uint64_t val;
+            ::read(events[i].data.fd, &val, sizeof(val));
+        }
+    }
+}
+
 Timer * Main_Control::sys_timer()
 {
     return m_systimer;
 }
 
+Log_Archiver * Main_Control::log_archiver()
+{
+    return m_archiver;
+}
+
+Drive_Worker * Main_Control::drive_worker()
+{
+    return m_drive_worker;
+}
+
 int Main_Control::add_subsystem(Subsystem * subsys)
 {
     uint32_t len = util::buf_len(systems_, MAX_SYSTEM_COUNT);
@@ -176,6 +367,7 @@ void Main_Control::mount_drive()
             {
                 ilog("Retrying mounted usb drive at /dev/sda1 to {}", mntpoint);
                 ++cur_retry_count;
+                usleep(1000 * USB_DRIVE_MOUNT_RETRY_MS);
             }
 
             if (cur_retry_count == max_retry_count)
@@ -243,18 +435,38 @@ void Main_Control::start()
         ilog("Successfully loaded config file at {}", _config_fname);
     }
 
+    Status_Log_Config lcfg;
+    fill_status_log_config_if_found(&cfg, "status_log", &lcfg);
+    logger_->configure(lcfg);
+
+    Log_Archive_Config acfg;
+    fill_log_archive_config_if_found(&cfg, "log_rotation", &acfg);
+    logger_->set_rotation(uint64_t(acfg.max_file_size_kb) * 1024, m_archiver);
+    m_archiver->start(acfg);
+
+    uint32_t drive_poll_ms = DEFAULT_USB_DRIVE_POLL_PERIOD_MS;
+    cfg.fill_param_if_found("usb_drive_poll_period_ms", &drive_poll_ms);
+    start_usb_drive_watch(drive_poll_ms);
+    m_drive_worker->start();
+
     init(&cfg);
     while (running())
     {
         update();
+        _wait_for_events();
     }
     m_systimer->stop();
     ilog("Stopping Radio Monitor - execution time {} ms", m_systimer->elapsed());
     release();
+    m_drive_worker->stop();
+    stop_usb_drive_watch();
+    m_archiver->stop();
+    logger_->set_rotation(uint64_t(acfg.max_file_size_kb) * 1024, nullptr);
     logger_->terminate();
 }
 
 void Main_Control::stop()
 {
     m_running = false;
+    wake();
 }
\ No newline at end of file
@@ -4,13 +4,22 @@
 
 #include <inttypes.h>
 #include <string>
+#include <atomic>
 
 const std::string USB_DRIVE_MNT_DIR = "/media/usb0";
+const std::string USB_DRIVE_DEV_DIR = "/dev";
+const std::string USB_DRIVE_DEV_NAME = "sda";
+const uint32_t DEFAULT_USB_DRIVE_POLL_PERIOD_MS = 2000;
+const uint32_t USB_DRIVE_MOUNT_RETRY_MS = 100;
 const uint32_t MAX_SYSTEM_COUNT = 10;
+const uint32_t MAIN_LOOP_MAX_WAIT_MS = 1000;
+const uint32_t MAIN_LOOP_MAX_EVENTS = 16;
 
 class Subsystem;
 class Timer;
 class Logger;
+class Log_Archiver;
+class Drive_Worker;
 class Config_File;
 
 class Main_Control
@@ -46,10 +55,19 @@ class Main_Control
 
     void restart_updated(const char * exe_path, const char * const params[]);
 
+    /// Whether the usb drive's device exists - once the drive watch is started this is kept up to date from inotify
+    /// events on the dev dir (or by polling every poll_ms if inotify isn't available) at the start of each update, so
+    /// it is cheap to call every loop
     bool usb_drive_detected();
 
+    void start_usb_drive_watch(uint32_t poll_ms);
+
+    void stop_usb_drive_watch();
+
+    /// Blocks until the drive is unmounted - use drive_worker() from the main loop
     void unmount_drive();
 
+    /// Blocks for seconds while the drive is mounted and settles - use drive_worker() from the main loop
     void mount_drive();
 
     void start();
@@ -60,7 +78,29 @@ class Main_Control
 
 	Timer * sys_timer();
 
+    /// Compresses and prunes the rotated log files (status log and loggers) - started once the config is loaded
+    Log_Archiver * log_archiver();
+
+    /// Mounts/unmounts the usb drive and loads the config off the main loop - started once the config is loaded
+    Drive_Worker * drive_worker();
+
     void update();
+
+    /// Wake the main loop so it runs an update right away - safe from any thread or a signal handler
+    void wake();
+
+    /// eventfd that wakes the main loop when signaled - hand it to io threads (ie Threaded_Fd::set_notify_fd)
+    int32_t wake_fd();
+
+    /// Ask for the next update to run no more than ms from now - subsystems call this from update() for their next
+    /// deadline (log period, timeouts, etc). Without any requests the loop still updates every MAIN_LOOP_MAX_WAIT_MS.
+    void schedule_update(double ms);
+
+    /// Wake the main loop whenever fd has any of events (EPOLLIN etc) - the fd is level triggered so the subsystem
+    /// must deal with it in update() or the loop won't sleep
+    bool watch_fd(int32_t fd, uint32_t events);
+
+    void unwatch_fd(int32_t fd);
     
     template<class T>
     void remove_subsystem()
@@ -79,9 +119,26 @@ class Main_Control
     Subsystem * get_subsystem(const char * sysname);
     
   private:
+    void _wait_for_events();
+    void _update_usb_drive_watch();
+
     bool m_running;
     std::string _config_fname;
     Subsystem * systems_[MAX_SYSTEM_COUNT];
 	Timer * m_systimer;
     Logger * logger_;
+    Log_Archiver * m_archiver;
+    Drive_Worker * m_drive_worker;
+
+    int32_t m_epoll_fd;
+    int32_t m_timer_fd;
+    int32_t m_wake_fd;
+    double m_next_update_ms;
+
+    // inotify fd watching the dev dir for the usb drive coming and going (-1 if not available)
+    int32_t m_drive_fd;
+    bool m_drive_watched;
+    std::atomic_bool m_drive_present;
+    uint32_t m_drive_poll_ms;
+    double m_next_drive_poll_ms;
 };
\ No newline at end of file
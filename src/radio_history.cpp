@@ -0,0 +1,400 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "radio_history.h"
+#include "radio_telemetry.h"
+#include "config_file.h"
+#include "logger.h"
+
+const uint32_t HISTORY_TIER_MS[HT_COUNT] = {1000, 60000, 3600000};
+
+History_Config::History_Config() : enabled(true), raw_samples(DEFAULT_HISTORY_RAW_SAMPLES), buckets()
+{
+    buckets[HT_SECOND] = DEFAULT_HISTORY_SECOND_BUCKETS;
+    buckets[HT_MINUTE] = DEFAULT_HISTORY_MINUTE_BUCKETS;
+    buckets[HT_HOUR] = DEFAULT_HISTORY_HOUR_BUCKETS;
+}
+
+bool fill_history_config_if_found(Config_File * cfg, const std::string & name, History_Config * hcfg)
+{
+    nlohmann::json obj;
+    if (!cfg->fill_param_if_found(name, &obj))
+        return false;
+
+    try
+    {
+        fill_param_if_found(obj, "enabled", &hcfg->enabled);
+        fill_param_if_found(obj, "raw_samples", &hcfg->raw_samples);
+        fill_param_if_found(obj, "second_buckets", &hcfg->buckets[HT_SECOND]);
+        fill_param_if_found(obj, "minute_buckets", &hcfg->buckets[HT_MINUTE]);
+        fill_param_if_found(obj, "hour_buckets", &hcfg->buckets[HT_HOUR]);
+    }
+    catch (nlohmann::detail::exception & e)
+    {
+        elog("Error for {} - using enabled {} raw_samples {} second_buckets {} minute_buckets {} hour_buckets {}",
+             name,
+             hcfg->enabled,
+             hcfg->raw_samples,
+             hcfg->buckets[HT_SECOND],
+             hcfg->buckets[HT_MINUTE],
+             hcfg->buckets[HT_HOUR]);
+        return false;
+    }
+
+    // The latest value is always kept as a raw sample
+    if (hcfg->raw_samples == 0)
+        hcfg->raw_samples = 1;
+    return true;
+}
+
+History_Condition::History_Condition()
+    : status(false),
+      less_than(std::numeric_limits<float>::lowest()),
+      greater_than(std::numeric_limits<float>::max()),
+      inside_band(false),
+      equal_mask(0)
+{}
+
+bool History_Condition::test(float value) const
+{
+    if (status)
+    {
+        uint8_t val = uint8_t(value);
+        return (equal_mask & val) == val;
+    }
+    if (inside_band)
+        return value < less_than && value > greater_than;
+    return value < less_than || value > greater_than;
+}
+
+bool History_Condition::test(const History_Bucket & bucket) const
+{
+    if (status)
+        return bucket.min == bucket.max && test(bucket.min);
+    if (inside_band)
+        return bucket.min > greater_than && bucket.max < less_than;
+    return bucket.max < less_than || bucket.min > greater_than;
+}
+
+Param_History::Param_History() : m_raw(), m_tiers(), m_last(), m_have_value(false), m_initialized(false)
+{}
+
+void Param_History::init(const History_Config & cfg)
+{
+    m_raw.resize(std::max(cfg.raw_samples, uint32_t(1)));
+    for (uint8_t i = 0; i < HT_COUNT; ++i)
+        m_tiers[i].ring.resize(cfg.buckets[i]);
+    m_have_value = false;
+    m_initialized = true;
+}
+
+bool Param_History::initialized() const
+{
+    return m_initialized;
+}
+
+void Param_History::add(int64_t t_ms, float value)
+{
+    // Only changes are kept - the row may have been touched for one of its other params
+    if (!m_initialized || (m_have_value && value == m_last.value))
+        return;
+
+    if (m_have_value && t_ms < m_last.t_ms)
+        t_ms = m_last.t_ms;
+
+    for (uint8_t i = 0; i < HT_COUNT; ++i)
+    {
+        Tier_State * ts = &m_tiers[i];
+        if (!m_have_value)
+        {
+            _start_bucket(ts, t_ms - t_ms % HISTORY_TIER_MS[i], t_ms, value);
+            continue;
+        }
+
+        _advance(ts, HISTORY_TIER_MS[i], t_ms);
+        ts->integral += double(m_last.value) * double(t_ms - ts->last_ms);
+        ts->last_ms = t_ms;
+        ts->cur.min = std::min(ts->cur.min, value);
+        ts->cur.max = std::max(ts->cur.max, value);
+    }
+
+    m_last.t_ms = t_ms;
+    m_last.value = value;
+    m_have_value = true;
+    m_raw.push(m_last);
+}
+
+const Fixed_Ring<History_Sample> & Param_History::raw() const
+{
+    return m_raw;
+}
+
+const Fixed_Ring<History_Bucket> & Param_History::tier(uint8_t tier) const
+{
+    return m_tiers[tier].ring;
+}
+
+bool Param_History::stats(int64_t from_ms, int64_t to_ms, History_Bucket * out) const
+{
+    if (!m_have_value || to_ms <= from_ms)
+        return false;
+
+    if (_stats_from_raw(from_ms, to_ms, out))
+        return true;
+
+    for (uint8_t i = 0; i < HT_COUNT; ++i)
+    {
+        const Tier_State & ts = m_tiers[i];
+        const Fixed_Ring<History_Bucket> & ring = ts.ring;
+        int64_t width = HISTORY_TIER_MS[i];
+
+        // A ring that isn't full yet goes back to the first value
+        if (ring.size() == 0 || (ring.full() && ring[0].start_ms > from_ms))
+            continue;
+
+        float mn = std::numeric_limits<float>::max();
+        float mx = std::numeric_limits<float>::lowest();
+        double weighted = 0.0;
+        int64_t covered = 0;
+        for (uint32_t j = 0; j < ring.size(); ++j)
+        {
+            const History_Bucket & b = ring[j];
+            int64_t overlap = std::min(b.start_ms + width, to_ms) - std::max(b.start_ms, from_ms);
+            if (overlap <= 0)
+                continue;
+            mn = std::min(mn, b.min);
+            mx = std::max(mx, b.max);
+            weighted += double(b.avg) * double(overlap);
+            covered += overlap;
+        }
+
+        // The bucket still being filled - the last value holds from the last sample on
+        int64_t cur_end = std::max(ts.last_ms, std::min(ts.cur.start_ms + width, to_ms));
+        int64_t overlap = std::min(cur_end, to_ms) - std::max(ts.from_ms, from_ms);
+        if (overlap > 0)
+        {
+            mn = std::min(mn, ts.cur.min);
+            mx = std::max(mx, ts.cur.max);
+            double cur_avg = m_last.value;
+            if (cur_end > ts.from_ms)
+                cur_avg = (ts.integral + double(m_last.value) * double(cur_end - ts.last_ms)) / double(cur_end - ts.from_ms);
+            weighted += cur_avg * double(overlap);
+            covered += overlap;
+        }
+
+        if (covered == 0)
+            return false;
+        out->start_ms = from_ms;
+        out->min = mn;
+        out->max = mx;
+        out->avg = float(weighted / double(covered));
+        return true;
+    }
+    return false;
+}
+
+bool Param_History::held(const History_Condition & cond, uint32_t hold_ms, int64_t now_ms) const
+{
+    if (!m_have_value)
+        return false;
+
+    // Walk back through the value changes - each one has been in effect until the one after it
+    int64_t since = now_ms - int64_t(hold_ms);
+    for (uint32_t i = m_raw.size(); i-- > 0;)
+    {
+        const History_Sample & s = m_raw[i];
+        if (!cond.test(s.value))
+            return false;
+        if (s.t_ms <= since)
+            return true;
+    }
+
+    // The param didn't have a value that long ago
+    if (!m_raw.full())
+        return false;
+
+    // Too many changes to go back far enough with the raw samples - use the finest tier that does, counting only the
+    // buckets from before the oldest raw sample
+    int64_t oldest = m_raw[0].t_ms;
+    for (uint8_t i = 0; i < HT_COUNT; ++i)
+    {
+        const Tier_State & ts = m_tiers[i];
+        const Fixed_Ring<History_Bucket> & ring = ts.ring;
+        if (ts.cur.start_ms > since && (ring.size() == 0 || ring[0].start_ms > since))
+        {
+            if (!ring.full())
+                return false;
+            continue;
+        }
+
+        if (ts.cur.start_ms < oldest)
+        {
+            if (!cond.test(ts.cur))
+                return false;
+            if (ts.cur.start_ms <= since)
+                return true;
+        }
+        for (uint32_t j = ring.size(); j-- > 0;)
+        {
+            const History_Bucket & b = ring[j];
+            if (b.start_ms >= oldest)
+                continue;
+            if (!cond.test(b))
+                return false;
+            if (b.start_ms <= since)
+                return true;
+        }
+        return false;
+    }
+    return false;
+}
+
+void Param_History::_start_bucket(Tier_State * ts, int64_t start_ms, int64_t from_ms, float value)
+{
+    ts->cur.start_ms = start_ms;
+    ts->cur.min = value;
+    ts->cur.max = value;
+    ts->cur.avg = value;
+    ts->integral = 0.0;
+    ts->from_ms = from_ms;
+    ts->last_ms = from_ms;
+}
+
+void Param_History::_advance(Tier_State * ts, uint32_t width, int64_t t_ms)
+{
+    int64_t end = ts->cur.start_ms + width;
+    if (t_ms < end)
+        return;
+
+    ts->integral += double(m_last.value) * double(end - ts->last_ms);
+    ts->cur.avg = float(ts->integral / double(end - ts->from_ms));
+    ts->ring.push(ts->cur);
+
+    // Buckets with no changes in them held the last value the whole time - only the ones that still fit in the ring
+    // are worth adding
+    int64_t skipped = (t_ms - end) / width;
+    if (skipped > int64_t(ts->ring.capacity()))
+    {
+        end += (skipped - ts->ring.capacity()) * int64_t(width);
+        skipped = ts->ring.capacity();
+    }
+    History_Bucket held = {0, m_last.value, m_last.value, m_last.value};
+    for (int64_t i = 0; i < skipped; ++i)
+    {
+        held.start_ms = end;
+        ts->ring.push(held);
+        end += width;
+    }
+    _start_bucket(ts, end, end, m_last.value);
+}
+
+bool Param_History::_stats_from_raw(int64_t from_ms, int64_t to_ms, History_Bucket * out) const
+{
+    // If the ring isn't full the first sample is the param's first value
+    if (m_raw.size() == 0 || (m_raw.full() && m_raw[0].t_ms > from_ms))
+        return false;
+
+    int64_t start = std::max(from_ms, m_raw[0].t_ms);
+    float mn = std::numeric_limits<float>::max();
+    float mx = std::numeric_limits<float>::lowest();
+    double weighted = 0.0;
+    for (uint32_t i = 0; i < m_raw.size(); ++i)
+    {
+        const History_Sample & s = m_raw[i];
+        int64_t seg_start = std::max(s.t_ms, start);
+        int64_t seg_end = to_ms;
+        if (i + 1 < m_raw.size())
+            seg_end = std::min(m_raw[i + 1].t_ms, to_ms);
+        if (seg_start >= to_ms)
+            break;
+        if (seg_end <= seg_start)
+            continue;
+        mn = std::min(mn, s.value);
+        mx = std::max(mx, s.value);
+        weighted += double(s.value) * double(seg_end - seg_start);
+    }
+
+    if (mn > mx)
+        return false;
+    out->start_ms = from_ms;
+    out->min = mn;
+    out->max = mx;
+    out->avg = float(weighted / double(to_ms - start));
+    return true;
+}
+
+Radio_History::Radio_History() : m_cfg(), m_params(), m_generation()
+{}
+
+void Radio_History::set_config(const History_Config & cfg)
+{
+    bool same = cfg.enabled == m_cfg.enabled && cfg.raw_samples == m_cfg.raw_samples;
+    for (uint8_t i = 0; i < HT_COUNT; ++i)
+        same = same && cfg.buckets[i] == m_cfg.buckets[i];
+    if (same)
+        return;
+
+    m_cfg = cfg;
+    clear();
+    ilog("Radio history {} - {} raw samples and {}/{}/{} second/minute/hour buckets per param",
+         m_cfg.enabled ? "enabled" : "disabled",
+         m_cfg.raw_samples,
+         m_cfg.buckets[HT_SECOND],
+         m_cfg.buckets[HT_MINUTE],
+         m_cfg.buckets[HT_HOUR]);
+}
+
+const History_Config & Radio_History::config() const
+{
+    return m_cfg;
+}
+
+void Radio_History::update(const Radio_Telemetry & tel)
+{
+    if (!m_cfg.enabled)
+        return;
+
+    uint32_t rows = tel.size();
+    if (m_generation.size() > rows)
+        clear();
+    if (m_generation.size() < rows)
+    {
+        m_generation.resize(rows, 0);
+        m_params.resize(size_t(rows) * LP_COUNT);
+    }
+
+    for (uint32_t row = 0; row < rows; ++row)
+    {
+        if (tel.generation[row] == m_generation[row])
+            continue;
+        m_generation[row] = tel.generation[row];
+
+        int64_t t_ms = int64_t(tel.updated_ms[row]);
+        for (uint8_t param = 0; param < LP_COUNT; ++param)
+        {
+            float value = tel.value(row, param);
+            if (value == INVALID_FLOAT || (log_param_is_status(param) && uint8_t(value) == INVALID_VALUE))
+                continue;
+
+            Param_History & ph = m_params[size_t(row) * LP_COUNT + param];
+            if (!ph.initialized())
+                ph.init(m_cfg);
+            ph.add(t_ms, value);
+        }
+    }
+}
+
+void Radio_History::clear()
+{
+    m_params.clear();
+    m_generation.clear();
+}
+
+const Param_History * Radio_History::get(uint32_t row, uint8_t param) const
+{
+    size_t ind = size_t(row) * LP_COUNT + param;
+    if (ind >= m_params.size() || !m_params[ind].initialized())
+        return nullptr;
+    return &m_params[ind];
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+
+#include "log_format.h"
+
+#define DEFAULT_HISTORY_RAW_SAMPLES 512
+#define DEFAULT_HISTORY_SECOND_BUCKETS 300
+#define DEFAULT_HISTORY_MINUTE_BUCKETS 120
+#define DEFAULT_HISTORY_HOUR_BUCKETS 48
+
+class Config_File;
+struct Radio_Telemetry;
+
+/// Rollup tiers, finest first
+enum History_Tier
+{
+    HT_SECOND,
+    HT_MINUTE,
+    HT_HOUR,
+    HT_COUNT
+};
+
+/// Bucket width of each History_Tier
+extern const uint32_t HISTORY_TIER_MS[HT_COUNT];
+
+/// How much history is kept for each param of each radio - this is all allocated up front, the first time the param
+/// has a value
+struct History_Config
+{
+    History_Config();
+
+    // 0 turns history off
+    bool enabled;
+
+    // Most recent value changes kept as is
+    uint32_t raw_samples;
+
+    // Rollup buckets kept for each tier
+    uint32_t buckets[HT_COUNT];
+};
+
+/// Fill hcfg from the json object name (with keys enabled, raw_samples, second_buckets, minute_buckets, hour_buckets)
+/// - keys not present are left as is
+bool fill_history_config_if_found(Config_File * cfg, const std::string & name, History_Config * hcfg);
+
+/// Ring of the last capacity items pushed - pushing to a full ring drops the oldest. Index 0 is the oldest.
+template<class T>
+class Fixed_Ring
+{
+  public:
+    Fixed_Ring() : m_items(), m_head(0), m_size(0)
+    {}
+
+    void resize(uint32_t capacity)
+    {
+        m_items.assign(capacity, T());
+        m_head = 0;
+        m_size = 0;
+    }
+
+    void push(const T & item)
+    {
+        if (m_items.empty())
+            return;
+        m_items[(m_head + m_size) % m_items.size()] = item;
+        if (m_size < m_items.size())
+            ++m_size;
+        else
+            m_head = (m_head + 1) % m_items.size();
+    }
+
+    const T & operator[](uint32_t ind) const
+    {
+        return m_items[(m_head + ind) % m_items.size()];
+    }
+
+    uint32_t size() const
+    {
+        return m_size;
+    }
+
+    uint32_t capacity() const
+    {
+        return m_items.size();
+    }
+
+    bool full() const
+    {
+        return m_size == m_items.size();
+    }
+
+  private:
+    std::vector<T> m_items;
+    uint32_t m_head;
+    uint32_t m_size;
+};
+
+/// A value as of t_ms - it stays in effect until the next sample
+struct History_Sample
+{
+    int64_t t_ms;
+    float value;
+};
+
+/// Rollup of the values in effect from start_ms for the tier's bucket width - avg is time weighted
+struct History_Bucket
+{
+    int64_t start_ms;
+    float min;
+    float max;
+    float avg;
+};
+
+/// What a value has to be for Param_History::held - a float outside (or inside) a band, or a status in a mask
+struct History_Condition
+{
+    History_Condition();
+
+    bool test(float value) const;
+
+    /// True only if every value in the bucket is known to pass
+    bool test(const History_Bucket & bucket) const;
+
+    bool status;
+    float less_than;
+    float greater_than;
+    bool inside_band;
+    uint8_t equal_mask;
+};
+
+/// History of one param of one radio - the raw value changes plus min/max/avg rollups for each tier
+class Param_History
+{
+  public:
+    Param_History();
+
+    void init(const History_Config & cfg);
+
+    bool initialized() const;
+
+    /// Record value as the param's value from t_ms on - ignored if it's the same as the last value
+    void add(int64_t t_ms, float value);
+
+    const Fixed_Ring<History_Sample> & raw() const;
+
+    /// Closed buckets of tier - the bucket still being filled isn't included
+    const Fixed_Ring<History_Bucket> & tier(uint8_t tier) const;
+
+    /// Min/max/avg of the values in effect from from_ms to to_ms, using the raw samples if they go back far enough and
+    /// the finest tier that does otherwise - false if nothing goes back that far
+    bool stats(int64_t from_ms, int64_t to_ms, History_Bucket * out) const;
+
+    /// True if every value in effect over the last hold_ms (up to now_ms) passed cond
+    bool held(const History_Condition & cond, uint32_t hold_ms, int64_t now_ms) const;
+
+  private:
+    struct Tier_State
+    {
+        Fixed_Ring<History_Bucket> ring;
+        History_Bucket cur;
+        // Time weighted sum of the values since from_ms (the first time in the bucket with a value) up to last_ms
+        double integral;
+        int64_t from_ms;
+        int64_t last_ms;
+    };
+
+    void _start_bucket(Tier_State * ts, int64_t start_ms, int64_t from_ms, float value);
+    void _advance(Tier_State * ts, uint32_t width, int64_t t_ms);
+    bool _stats_from_raw(int64_t from_ms, int64_t to_ms, History_Bucket * out) const;
+
+    Fixed_Ring<History_Sample> m_raw;
+    Tier_State m_tiers[HT_COUNT];
+    History_Sample m_last;
+    bool m_have_value;
+    bool m_initialized;
+};
+
+/// History for every param of every telemetry row
+class Radio_History
+{
+  public:
+    Radio_History();
+
+    void set_config(const History_Config & cfg);
+
+    const History_Config & config() const;
+
+    /// Record the values of every row whose generation changed since the last call - rows are matched to telemetry
+    /// rows by index, so clear this whenever the telemetry is cleared
+    void update(const Radio_Telemetry & tel);
+
+    void clear();
+
+    /// Null if the row's param has never had a value
+    const Param_History * get(uint32_t row, uint8_t param) const;
+
+  private:
+    History_Config m_cfg;
+    std::vector<Param_History> m_params;
+    std::vector<uint32_t> m_generation;
+};
@@ -0,0 +1,83 @@
+#include "radio_telemetry.h"
+#include "log_format.h"
+#include "utility.h"
+
+uint32_t Radio_Telemetry::add_row()
+{
+    freq_mhz.push_back(0.0f);
+    is_tx.push_back(0);
+    ptt_status.push_back(INVALID_VALUE);
+    forward_power.push_back(INVALID_FLOAT);
+    reverse_power.push_back(INVALID_FLOAT);
+    vswr.push_back(INVALID_FLOAT);
+    squelch_status.push_back(INVALID_VALUE);
+    agc.push_back(INVALID_FLOAT);
+    line_level.push_back(INVALID_FLOAT);
+    generation.push_back(0);
+    updated_ms.push_back(0.0);
+    return freq_mhz.size() - 1;
+}
+
+uint32_t Radio_Telemetry::add_row(const Radio_Telemetry & from, uint32_t row)
+{
+    freq_mhz.push_back(from.freq_mhz[row]);
+    is_tx.push_back(from.is_tx[row]);
+    ptt_status.push_back(from.ptt_status[row]);
+    forward_power.push_back(from.forward_power[row]);
+    reverse_power.push_back(from.reverse_power[row]);
+    vswr.push_back(from.vswr[row]);
+    squelch_status.push_back(from.squelch_status[row]);
+    agc.push_back(from.agc[row]);
+    line_level.push_back(from.line_level[row]);
+    generation.push_back(from.generation[row]);
+    updated_ms.push_back(from.updated_ms[row]);
+    return freq_mhz.size() - 1;
+}
+
+void Radio_Telemetry::clear()
+{
+    freq_mhz.clear();
+    is_tx.clear();
+    ptt_status.clear();
+    forward_power.clear();
+    reverse_power.clear();
+    vswr.clear();
+    squelch_status.clear();
+    agc.clear();
+    line_level.clear();
+    generation.clear();
+    updated_ms.clear();
+}
+
+uint32_t Radio_Telemetry::size() const
+{
+    return freq_mhz.size();
+}
+
+void Radio_Telemetry::touch(uint32_t row)
+{
+    ++generation[row];
+    updated_ms[row] = util::monotonic_ms();
+}
+
+float Radio_Telemetry::value(uint32_t row, uint8_t param) const
+{
+    switch (param)
+    {
+    case LP_PTT_STATUS:
+        return ptt_status[row];
+    case LP_FORWARD_POWER:
+        return forward_power[row];
+    case LP_REVERSE_POWER:
+        return reverse_power[row];
+    case LP_VSWR:
+        return vswr[row];
+    case LP_SQUELCH_STATUS:
+        return squelch_status[row];
+    case LP_AGC:
+        return agc[row];
+    case LP_LINE_LEVEL:
+        return line_level[row];
+    }
+    return INVALID_FLOAT;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <inttypes.h>
+#include <vector>
+
+const uint8_t INVALID_VALUE = -1;
+const float INVALID_FLOAT = -100.0f;
+
+/// The values read from every radio, stored column wise - one array per field with a row per radio. Connection and
+/// parsing state stays in CM300_Radio, so a pass over all the radios (checking logger conditions, snapshotting a row)
+/// only walks the small arrays it needs rather than striding over sockets and response buffers.
+struct Radio_Telemetry
+{
+    /// Add a row with every value invalid - returns its index
+    uint32_t add_row();
+
+    /// Add a row with the values of row in from - returns its index
+    uint32_t add_row(const Radio_Telemetry & from, uint32_t row);
+
+    void clear();
+
+    uint32_t size() const;
+
+    /// Mark row as changed - call whenever one of its values actually changes
+    void touch(uint32_t row);
+
+    /// The row's value for a Log_Param - status values are returned as floats
+    float value(uint32_t row, uint8_t param) const;
+
+    std::vector<float> freq_mhz;
+
+    // 1 for transmitters (from the serial) - the rest are treated as receivers
+    std::vector<uint8_t> is_tx;
+
+    // TX values
+    std::vector<uint8_t> ptt_status;
+    std::vector<float> forward_power;
+    std::vector<float> reverse_power;
+    std::vector<float> vswr;
+
+    // RX values
+    std::vector<uint8_t> squelch_status;
+    std::vector<float> agc;
+    std::vector<float> line_level;
+
+    // Bumped by touch() along with the monotonic time (ms) of the change
+    std::vector<uint32_t> generation;
+    std::vector<double> updated_ms;
+};
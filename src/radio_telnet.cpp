@@ -5,12 +5,17 @@
 #include <stdio.h>
 #include <cmath>
 #include <random>
+#include <poll.h>
 
 #include "config_file.h"
 #include "utility.h"
 #include "main_control.h"
 #include "logger.h"
 #include "radio_telnet.h"
+#include "fd_reactor.h"
+#include "log_writer.h"
+#include "drive_worker.h"
+#include "binary_log.h"
 #include "timer.h"
 
 #define STR_PRECISION(str, precision) str.substr(0, str.find('.') + precision + 1)
@@ -34,20 +39,23 @@ const uint8_t RSTAT = 3;
 } // namespace ind
 } // namespace cmd
 
-static int resp_len = 0;
-
 void default_radio_params(CM300_Radio * rad)
 {
-    rad->tx.forward_power = 0;
-    rad->tx.reverse_power = 0;
-    rad->tx.vswr = -1.0;
-    rad->tx.ptt_status = PTT_OFF;
-    rad->rx.agc = 1.61;
-    rad->rx.line_level = -46.0;
-    rad->rx.squelch_status = SQUELCH_CLOSED;
+    TX_Params tx;
+    tx.forward_power = 0;
+    tx.reverse_power = 0;
+    tx.vswr = -1.0;
+    tx.ptt_status = PTT_OFF;
+    rad->set_tx(tx);
+
+    RX_Params rx;
+    rx.agc = 1.61;
+    rx.line_level = -46.0;
+    rx.squelch_status = SQUELCH_CLOSED;
+    rad->set_rx(rx);
 }
 
-void create_simulated_radio_set(std::vector<CM300_Radio> & radios, int vcount, int ucount)
+void create_simulated_radio_set(std::vector<CM300_Radio> & radios, Radio_Telemetry & tel, int vcount, int ucount)
 {
     std::string uprefix("2U");
     std::set<int> used_rnums;
@@ -78,7 +86,10 @@ void create_simulated_radio_set(std::vector<CM300_Radio> & radios, int vcount, i
         numstr.insert(0, 6 - numstr.size(), '0');
         rad.serial.append(numstr);
 
-        rad.freq_mhz = f;
+        rad.telemetry = &tel;
+        rad.row = tel.add_row();
+        tel.freq_mhz[rad.row] = f;
+        tel.is_tx[rad.row] = rad.is_tx();
         default_radio_params(&rad);
         radios.push_back(rad);
     }
@@ -105,34 +116,60 @@ void create_simulated_radio_set(std::vector<CM300_Radio> & radios, int vcount, i
         numstr.insert(0, 6 - numstr.size(), '0');
         rad.serial.append(numstr);
 
-        rad.freq_mhz = f;
+        rad.telemetry = &tel;
+        rad.row = tel.add_row();
+        tel.freq_mhz[rad.row] = f;
+        tel.is_tx[rad.row] = rad.is_tx();
         default_radio_params(&rad);
         radios.push_back(rad);
     }
 }
 
-std::string ptt_string(uint8_t status)
+static const float * float_column(const Radio_Telemetry & tel, uint8_t param)
 {
-    if (status == PTT_OFF)
-        return "Off";
-    else if (status == PTT_LOCAL)
-        return "Key(L)";
-    else if (status == PTT_REMOTE)
-        return "Key(R)";
-    else if (status == PTT_TEST_RF)
-        return "Key(T)";
-    else
-        return "Invalid";
+    switch (param)
+    {
+    case LP_FORWARD_POWER:
+        return tel.forward_power.data();
+    case LP_REVERSE_POWER:
+        return tel.reverse_power.data();
+    case LP_VSWR:
+        return tel.vswr.data();
+    case LP_AGC:
+        return tel.agc.data();
+    case LP_LINE_LEVEL:
+        return tel.line_level.data();
+    }
+    return nullptr;
 }
 
-std::string squelch_string(uint8_t status)
+static const uint8_t * status_column(const Radio_Telemetry & tel, uint8_t param)
 {
-    if (status == SQUELCH_OPEN)
-        return "Open";
-    else if (status == SQUELCH_CLOSED)
-        return "Clsd";
-    else
-        return "Invalid";
+    if (param == LP_PTT_STATUS)
+        return tel.ptt_status.data();
+    return tel.squelch_status.data();
+}
+
+static float log_param_value(const TX_Params & tx, const RX_Params & rx, uint8_t param)
+{
+    switch (param)
+    {
+    case LP_PTT_STATUS:
+        return tx.ptt_status;
+    case LP_FORWARD_POWER:
+        return tx.forward_power;
+    case LP_REVERSE_POWER:
+        return tx.reverse_power;
+    case LP_VSWR:
+        return tx.vswr;
+    case LP_SQUELCH_STATUS:
+        return rx.squelch_status;
+    case LP_AGC:
+        return rx.agc;
+    case LP_LINE_LEVEL:
+        return rx.line_level;
+    }
+    return INVALID_FLOAT;
 }
 
 TX_Params::TX_Params() : ptt_status(INVALID_VALUE), forward_power(INVALID_FLOAT), reverse_power(INVALID_FLOAT), vswr(INVALID_FLOAT)
@@ -183,43 +220,45 @@ bool RX_Params::initialized() const
 
 CM300_Radio::CM300_Radio()
     : sk(nullptr),
-      freq_mhz(0.0),
       serial(),
-      tx(),
-      rx(),
-      cur_cmd(INVALID_VALUE),
+      telemetry(nullptr),
+      row(0),
+      pending_cmds{0},
+      pending_count(0),
+      last_sent_cmd(INVALID_VALUE),
       prev_cmd(INVALID_VALUE),
-      buffer_offset(0),
       response_buffer{0},
-      retry_count(5),
+      prompt_matcher(RESPONSE_COMPLETE_STR),
+      parser(),
+      retry_count(0),
       complete_scan_count(0)
 {}
 
 CM300_Radio::~CM300_Radio()
 {}
 
+void CM300_Radio::reset_commands()
+{
+    prompt_matcher.reset();
+    parser.reset();
+    pending_cmds[0] = cmd::ind::FREQ;
+    pending_count = 1;
+    last_sent_cmd = cmd::ind::FREQ;
+}
+
 std::string CM300_Radio::radio_type() const
 {
-    std::string ret;
-    if (serial.find('T') != std::string::npos)
-        ret = TX_STR;
-    else if (serial.find('R') != std::string::npos)
-        ret = RX_STR;
-    else
-        ret = NOT_READY_STR;
-    return ret;
+    return radio_type_string(serial.c_str());
 }
 
 std::string CM300_Radio::radio_range() const
 {
-    std::string ret;
-    if (serial.find('U') != std::string::npos)
-        ret = "UHF";
-    else if (serial.find('V') != std::string::npos)
-        ret = "VHF";
-    else
-        ret = NOT_READY_STR;
-    return ret;
+    return radio_range_string(serial.c_str());
+}
+
+bool CM300_Radio::is_tx() const
+{
+    return serial.find('T') != std::string::npos;
 }
 
 std::string CM300_Radio::to_string() const
@@ -231,21 +270,150 @@ std::string CM300_Radio::to_string() const
         ret += "Not Initialized\n";
     ret += "Type: " + radio_type() + "\n";
     ret += "Range: " + radio_range() + "\n";
-    ret += "Frequency: " + NUM_2_STR(freq_mhz, 2) + "\n";
+    ret += "Frequency: " + NUM_2_STR(freq_mhz(), 2) + "\n";
     auto type = radio_type();
     if (type == TX_STR)
-        ret += tx.to_string();
+        ret += tx().to_string();
     else if (type == RX_STR)
-        ret += rx.to_string();
+        ret += rx().to_string();
+    return ret;
+}
+
+float CM300_Radio::freq_mhz() const
+{
+    return telemetry->freq_mhz[row];
+}
+
+TX_Params CM300_Radio::tx() const
+{
+    TX_Params ret;
+    ret.ptt_status = telemetry->ptt_status[row];
+    ret.forward_power = telemetry->forward_power[row];
+    ret.reverse_power = telemetry->reverse_power[row];
+    ret.vswr = telemetry->vswr[row];
+    return ret;
+}
+
+RX_Params CM300_Radio::rx() const
+{
+    RX_Params ret;
+    ret.squelch_status = telemetry->squelch_status[row];
+    ret.agc = telemetry->agc[row];
+    ret.line_level = telemetry->line_level[row];
     return ret;
 }
 
+void CM300_Radio::set_tx(const TX_Params & params)
+{
+    telemetry->ptt_status[row] = params.ptt_status;
+    telemetry->forward_power[row] = params.forward_power;
+    telemetry->reverse_power[row] = params.reverse_power;
+    telemetry->vswr[row] = params.vswr;
+    telemetry->touch(row);
+}
+
+void CM300_Radio::set_rx(const RX_Params & params)
+{
+    telemetry->squelch_status[row] = params.squelch_status;
+    telemetry->agc[row] = params.agc;
+    telemetry->line_level[row] = params.line_level;
+    telemetry->touch(row);
+}
+
+Radio_Sample::Radio_Sample() : serial(), freq_mhz(0), tx(), rx()
+{}
+
+Radio_Sample::Radio_Sample(const CM300_Radio & radio) : serial(), freq_mhz(radio.freq_mhz()), tx(radio.tx()), rx(radio.rx())
+{
+    strncpy(serial, radio.serial.c_str(), RADIO_SERIAL_SIZE - 1);
+}
+
+std::string Radio_Sample::radio_type() const
+{
+    return radio_type_string(serial);
+}
+
+std::string Radio_Sample::radio_range() const
+{
+    return radio_range_string(serial);
+}
+
+bool Radio_Sample::is_tx() const
+{
+    return strchr(serial, 'T') != nullptr;
+}
+
+bool Radio_Sample::is_rx() const
+{
+    return !is_tx() && strchr(serial, 'R') != nullptr;
+}
+
+Logger_Options::Logger_Options()
+    : dir_path(), period(0), log_changes_to_status(false), format(LOG_FORMAT_CSV), items(), enabled_mask(0), columns(), hold_mask(0)
+{}
+
+void Logger_Options::compile()
+{
+    columns.tx_column_count = 0;
+    columns.rx_column_count = 0;
+    hold_mask = 0;
+    for (uint8_t i = 0; i < LP_COUNT; ++i)
+    {
+        columns.titles[i] = LOG_PARAM_NAMES[i];
+        if (!enabled(i))
+            continue;
+
+        if (items[i].title.enabled)
+            columns.titles[i] = items[i].title.val;
+
+        const Log_Option_Group & opt = items[i];
+        status_triggers[i].change = opt.change.enabled;
+        status_triggers[i].equal = opt.equal.enabled;
+        status_triggers[i].equal_mask = opt.equal.val;
+
+        Float_Trigger & ft = float_triggers[i];
+        if (opt.change.enabled)
+            ft.change = opt.change.val;
+        if (opt.percent_change.enabled)
+            ft.percent_change = opt.percent_change.val;
+        if (opt.less_than.enabled)
+            ft.less_than = opt.less_than.val;
+        if (opt.greater_than.enabled)
+            ft.greater_than = opt.greater_than.val;
+        ft.inside_band = (opt.less_than.enabled && opt.greater_than.enabled && (opt.less_than.val > opt.greater_than.val));
+
+        // A held level condition is taken out of the kernels' thresholds so only the history check can trigger it
+        if (opt.hold_ms.enabled && (opt.equal.enabled || opt.less_than.enabled || opt.greater_than.enabled))
+        {
+            History_Condition & cond = held[i];
+            cond.status = log_param_is_status(i);
+            cond.equal_mask = status_triggers[i].equal ? status_triggers[i].equal_mask : 0;
+            cond.less_than = ft.less_than;
+            cond.greater_than = ft.greater_than;
+            cond.inside_band = ft.inside_band;
+            status_triggers[i].equal = 0;
+            ft.less_than = Float_Trigger().less_than;
+            ft.greater_than = Float_Trigger().greater_than;
+            hold_mask |= (1u << i);
+        }
+        if (i < LP_SQUELCH_STATUS)
+            columns.tx_columns[columns.tx_column_count++] = i;
+        else
+            columns.rx_columns[columns.rx_column_count++] = i;
+    }
+}
+
+bool Logger_Options::enabled(uint8_t param) const
+{
+    return (enabled_mask & (1u << param)) != 0;
+}
+
 bool CM300_Radio::initialized() const
 {
     bool init = true;
     init = init && !serial.empty();
-    init = init && (freq_mhz > EPS);
-    return init && (rx.initialized() || tx.initialized());
+    init = init && (freq_mhz() > EPS);
+    return init && (rx().initialized() || tx().initialized());
 }
 
 Radio_Telnet::Radio_Telnet()
@@ -259,19 +427,36 @@ Radio_Telnet::Radio_Telnet()
       _ip_ub(13),
       _max_retry_count(10),
       _conn_timeout(0, 500000),
+      _discovery_window(DEFAULT_DISCOVERY_WINDOW),
+      _pipeline_depth(1),
+      _io_worker_count(DEFAULT_REACTOR_WORKER_COUNT),
+      _reactor(new Fd_Reactor),
+      _socket_buffers(Socket::default_buffer_config()),
+      _csv_file_cfg(),
+      _csv_queue_size(DEFAULT_LOG_WRITER_QUEUE_SIZE),
+      _log_writer(new Log_Writer),
+      _series_chunk_points(SERIES_DEFAULT_CHUNK_POINTS),
+      _series_chunk_span_ms(SERIES_DEFAULT_CHUNK_SPAN_MS),
+      _reconnect_min_delay_ms(DEFAULT_RECONNECT_MIN_DELAY_MS),
+      _reconnect_max_delay_ms(DEFAULT_RECONNECT_MAX_DELAY_MS),
+      _reconnect(new Reconnect_Service),
+      _reconnect_results(),
       all_radios_init(false),
       _cur_cmd(INVALID_VALUE),
       commands{cmd::str::ID, cmd::str::FREQ, cmd::str::MEAS, cmd::str::RSTAT},
       complete_scans(0)
-{
-    resp_len = strlen(RESPONSE_COMPLETE_STR);
-}
+{}
 
 Radio_Telnet::~Radio_Telnet()
-{}
+{
+    delete _log_writer;
+    delete _reconnect;
+    delete _reactor;
+}
 
-void parse_item_groupj(const nlohmann::json & source, const std::string & name, Logger_Entry * le)
+void parse_item_groupj(const nlohmann::json & source, uint8_t param, Logger_Entry * le)
 {
+    std::string name(LOG_PARAM_NAMES[param]);
     nlohmann::json option_obj;
     try
     {
@@ -288,7 +473,7 @@ void parse_item_groupj(const nlohmann::json & source, const std::string & name,
                 elog("Error for title is in parent json object {}", name);
             }
 
-            if (name == "ptt_status" || name == "squelch_status")
+            if (log_param_is_status(param))
             {
                 try
                 {
@@ -300,6 +485,15 @@ void parse_item_groupj(const nlohmann::json & source, const std::string & name,
                 }
 
                 log.change.enabled = MAP_CONTAINS(option_obj, "change");
+
+                try
+                {
+                    log.hold_ms.enabled = fill_param_if_found(option_obj, "hold_ms", &log.hold_ms.val);
+                }
+                catch (nlohmann::detail::exception & e)
+                {
+                    elog("Error for hold_ms is in parent json object {}", name);
+                }
                 if (log.equal.enabled)
                 {
                     util::to_lower(str);
@@ -359,8 +553,18 @@ void parse_item_groupj(const nlohmann::json & source, const std::string & name,
                 {
                     elog("Error for greater_than is in parent json object {}", name);
                 }
+
+                try
+                {
+                    log.hold_ms.enabled = fill_param_if_found(option_obj, "hold_ms", &log.hold_ms.val);
+                }
+                catch (nlohmann::detail::exception & e)
+                {
+                    elog("Error for hold_ms is in parent json object {}", name);
+                }
             }
-            le->loptions.item_options[name] = log;
+            le->loptions.items[param] = log;
+            le->loptions.enabled_mask |= (1u << param);
         }
     }
     catch (nlohmann::detail::exception & e)
@@ -369,7 +573,7 @@ void parse_item_groupj(const nlohmann::json & source, const std::string & name,
     }
 }
 
-void Radio_Telnet::_set_options_from_config_file(Config_File * cfg)
+void Radio_Telnet::_set_options_from_config_file(Config_File * cfg, std::unordered_map<std::string, Logger_Entry> * loggers)
 {
     nlohmann::json obj;
 
@@ -380,6 +584,69 @@ void Radio_Telnet::_set_options_from_config_file(Config_File * cfg)
     cfg->fill_param_if_found("simulation_random_squelch_break_period_count", &_simulated_random_sq_period_count);
     cfg->fill_param_if_found("ip_lower_bound", &_ip_lb);
     cfg->fill_param_if_found("ip_upper_bound", &_ip_ub);
+    cfg->fill_param_if_found("max_radio_retry_reconnect_count", &_max_retry_count);
+    cfg->fill_param_if_found("discovery_window", &_discovery_window);
+    cfg->fill_param_if_found("command_pipeline_depth", &_pipeline_depth);
+    if (_pipeline_depth < 1 || _pipeline_depth > MAX_COMMAND_PIPELINE_DEPTH)
+    {
+        wlog("command_pipeline_depth of {} is out of range - clamping to 1 to {}", _pipeline_depth, MAX_COMMAND_PIPELINE_DEPTH);
+        _pipeline_depth = std::min(std::max(_pipeline_depth, uint8_t(1)), MAX_COMMAND_PIPELINE_DEPTH);
+    }
+    cfg->fill_param_if_found("io_worker_count", &_io_worker_count);
+    fill_buffer_config_if_found(cfg, "socket_buffers", &_socket_buffers);
+
+    nlohmann::json timeout_obj;
+    if (cfg->fill_param_if_found("connection_timeout", &timeout_obj))
+    {
+        try
+        {
+            fill_param_if_found(timeout_obj, "seconds", &_conn_timeout.secs);
+            fill_param_if_found(timeout_obj, "microseconds", &_conn_timeout.usecs);
+        }
+        catch (nlohmann::detail::exception & e)
+        {
+            elog("Error for connection_timeout - using {}s {}us", _conn_timeout.secs, _conn_timeout.usecs);
+        }
+    }
+
+    nlohmann::json backoff_obj;
+    if (cfg->fill_param_if_found("reconnect_backoff", &backoff_obj))
+    {
+        try
+        {
+            fill_param_if_found(backoff_obj, "min_delay_ms", &_reconnect_min_delay_ms);
+            fill_param_if_found(backoff_obj, "max_delay_ms", &_reconnect_max_delay_ms);
+        }
+        catch (nlohmann::detail::exception & e)
+        {
+            elog("Error for reconnect_backoff - using {}ms to {}ms", _reconnect_min_delay_ms, _reconnect_max_delay_ms);
+        }
+    }
+
+    nlohmann::json csv_obj;
+    cfg->fill_param_if_found("csv_file", &csv_obj);
+    fill_log_file_config_if_found(cfg, "csv_file", &_csv_file_cfg);
+    cfg->fill_param_if_found("csv_queue_size", &_csv_queue_size);
+
+    nlohmann::json series_obj;
+    if (cfg->fill_param_if_found("series_file", &series_obj))
+    {
+        try
+        {
+            fill_param_if_found(series_obj, "chunk_points", &_series_chunk_points);
+            fill_param_if_found(series_obj, "chunk_span_ms", &_series_chunk_span_ms);
+        }
+        catch (nlohmann::detail::exception & e)
+        {
+            elog("Error for series_file - using {} points and {}ms per chunk", _series_chunk_points, _series_chunk_span_ms);
+        }
+    }
+
+    nlohmann::json history_obj;
+    cfg->fill_param_if_found("history", &history_obj);
+    fill_history_config_if_found(cfg, "history", &_history_cfg);
+    _history.set_config(_history_cfg);
+
     cfg->fill_param_if_found("loggers", &obj);
 
     // Now look in the sub obj for the per logger info
@@ -435,15 +702,45 @@ void Radio_Telnet::_set_options_from_config_file(Config_File * cfg)
             elog("Error for log_changes_to_status is in parent json object {}", iter.key());
         }
 
-        parse_item_groupj(*iter, "ptt_status", &le);
-        parse_item_groupj(*iter, "squelch_status", &le);
-        parse_item_groupj(*iter, "forward_power", &le);
-        parse_item_groupj(*iter, "reverse_power", &le);
-        parse_item_groupj(*iter, "vswr", &le);
-        parse_item_groupj(*iter, "agc", &le);
-        parse_item_groupj(*iter, "line_level", &le);
+        try
+        {
+            std::string format;
+            if (fill_param_if_found(*iter, "format", &format))
+            {
+                util::to_lower(format);
+                if (format == "binary")
+                    le.loptions.format = LOG_FORMAT_BINARY;
+                else if (format == "series")
+                    le.loptions.format = LOG_FORMAT_SERIES;
+                else if (format != "csv")
+                    wlog("Unknown format {} for logger {} - using csv", format, iter.key());
+            }
+        }
+        catch (nlohmann::detail::exception & e)
+        {
+            elog("Error for format is in parent json object {}", iter.key());
+        }
 
-        _loggers[iter.key()] = le;
+        for (uint8_t param = 0; param < LP_COUNT; ++param)
+            parse_item_groupj(*iter, param, &le);
+        le.loptions.compile();
+        if (le.loptions.hold_mask != 0 && !_history_cfg.enabled)
+            wlog("Logger {} has hold_ms conditions but history is disabled - they will never trigger", iter.key());
+
+        le.file->set_config(_csv_file_cfg);
+        le.writer = _log_writer;
+
+        // Rotated files in both the log dir and the backup dir are left to the archiver
+        le.archiver = edm.log_archiver();
+        le.max_file_size = uint64_t(le.archiver->config().max_file_size_kb) * 1024;
+
+        // Everything above that shapes the entry - a logger whose signature is unchanged is kept as is on a reload
+        le.cfg_signature = iter->dump() + csv_obj.dump() + series_obj.dump() + history_obj.dump() + std::to_string(le.max_file_size);
+        le.archiver->watch(le.loptions.dir_path.empty() ? "." : le.loptions.dir_path, le.name + " (");
+        le.archiver->watch(le._backup_log_dir, le.name + " (");
+        if (le.loptions.format == LOG_FORMAT_SERIES)
+            le.series = std::make_shared<Series_Writer>(_series_chunk_points, _series_chunk_span_ms);
+        (*loggers)[iter.key()] = le;
         ++iter;
     }
 }
@@ -451,7 +748,13 @@ void Radio_Telnet::_set_options_from_config_file(Config_File * cfg)
 void Radio_Telnet::init(Config_File * config)
 {
     Subsystem::init(config);
-    _set_options_from_config_file(config);
+    _set_options_from_config_file(config, &_loggers);
+    _reactor->start(_io_worker_count);
+    _log_writer->start(_csv_queue_size);
+
+    _reconnect->set_notify_fd(edm.wake_fd());
+    _reconnect->start(_reconnect_config(), _socket_buffers);
+
     _init_radios();
 }
 
@@ -471,49 +774,165 @@ void Radio_Telnet::_init_radios()
              _simulation_period,
              _simulated_random_sq_period_count,
              _simulated_high_vswr_period_count);
-        create_simulated_radio_set(_radios, vcount, ucount);
+        create_simulated_radio_set(_radios, _telemetry, vcount, ucount);
     }
     else
     {
-        for (int8_t i = 0; i < size; ++i)
+        std::vector<int32_t> hosts;
+        for (int32_t host = _ip_lb; host <= _ip_ub; ++host)
+            hosts.push_back(host);
+
+        std::vector<Socket *> found;
+        _discover_radios(hosts, found);
+        for (size_t i = 0; i < found.size(); ++i)
         {
-            if (!edm.running())
+            CM300_Radio rad;
+            if (!found[i] || !_start_radio(found[i], &rad))
+                continue;
+            rad.telemetry = &_telemetry;
+            rad.row = _telemetry.add_row();
+            _radios.push_back(rad);
+        }
+    }
+}
+
+bool Radio_Telnet::_start_radio(Socket * sk, CM300_Radio * radio)
+{
+    radio->sk = sk;
+    radio->ip = sk->get_ip();
+    radio->sk->set_reactor(_reactor);
+    radio->sk->set_notify_fd(edm.wake_fd());
+    if (!radio->sk->start())
+    {
+        ilog("Could not start socket for {} on threaded fd: {}", radio->sk->get_ip(), Threaded_Fd::error_string(radio->sk->error()));
+        delete radio->sk;
+        radio->sk = nullptr;
+        return false;
+    }
+    ilog("Opened connection to radio at {} on socket fd {}", radio->sk->get_ip(), radio->sk->fd());
+    radio->reset_commands();
+    return true;
+}
+
+void Radio_Telnet::_discover_radios(const std::vector<int32_t> & hosts, std::vector<Socket *> & found)
+{
+    struct Pending_Connect
+    {
+        Socket * sk;
+        size_t ind;
+        double deadline;
+    };
+
+    int32_t size = hosts.size();
+    if (size <= 0)
+        return;
+    found.assign(size, nullptr);
+
+    uint32_t window = (_discovery_window == 0) ? 1 : _discovery_window;
+    double timeout_ms = _conn_timeout.to_ms();
+    std::vector<Pending_Connect> pending;
+    std::vector<pollfd> pfds;
+    pending.reserve(window);
+    pfds.reserve(window);
+
+    ilog("Scanning for radios at {}{} to {}{} with up to {} connects in flight", RADIO_IP_PREFIX, hosts.front(), RADIO_IP_PREFIX, hosts.back(), window);
+    Timer sweep_timer;
+    sweep_timer.start();
+
+    int32_t next = 0;
+    while (next < size || !pending.empty())
+    {
+        if (!edm.running())
+        {
+            ilog("Breaking from radio discovery as process was stopped");
+            break;
+        }
+        sweep_timer.update();
+
+        // Keep the window full of in-flight connects
+        while (pending.size() < window && next < size)
+        {
+            std::string ip = RADIO_IP_PREFIX + std::to_string(hosts[next]);
+            Socket * sk = new Socket(_socket_buffers);
+            if (sk->fd() == -1)
+            {
+                ilog("Failed to create socket for {} - error: {}", ip, strerror(errno));
+                delete sk;
+            }
+            else if (sk->begin_connect(ip, RADIO_PORT) == 0)
             {
-                ilog("Breaking from radio init after {} radios as process was stopped", i + 1);
-                return;
+                found[next] = sk;
             }
+            else if (errno == EINPROGRESS)
+            {
+                Pending_Connect pc = {sk, size_t(next), sweep_timer.elapsed() + timeout_ms};
+                pending.push_back(pc);
+            }
+            else
+            {
+                ilog("Could not connect to {} - {}", ip, strerror(errno));
+                delete sk;
+            }
+            ++next;
+        }
 
-            std::string ip_last_octet = std::to_string(_ip_lb + i);
-            std::string ip = "192.168.102." + ip_last_octet;
+        if (pending.empty())
+            continue;
 
-            CM300_Radio rad;
-            rad.sk = new Socket();
+        double wait_ms = timeout_ms;
+        pfds.clear();
+        for (size_t i = 0; i < pending.size(); ++i)
+        {
+            pollfd pfd = {};
+            pfd.fd = pending[i].sk->fd();
+            pfd.events = POLLOUT;
+            pfds.push_back(pfd);
+            wait_ms = std::min(wait_ms, pending[i].deadline - sweep_timer.elapsed());
+        }
+
+        int32_t cnt = poll(pfds.data(), pfds.size(), std::max(int32_t(wait_ms), 0));
+        if (cnt < 0 && errno != EINTR)
+        {
+            elog("Poll failed during radio discovery: {}", strerror(errno));
+            break;
+        }
+        sweep_timer.update();
 
-            if (rad.sk->fd() == -1)
+        // Harvest completions and timeouts - walk backwards so erasing keeps pfds and pending lined up
+        for (int32_t i = int32_t(pending.size()) - 1; i >= 0; --i)
+        {
+            Pending_Connect & pc = pending[i];
+            if (pfds[i].revents != 0)
             {
-                ilog("Failed to create socket for {} - error: ", ip, strerror(errno));
-                delete rad.sk;
-                continue;
+                if (pc.sk->finish_connect() == 0)
+                {
+                    found[pc.ind] = pc.sk;
+                }
+                else
+                {
+                    ilog("No radio at {} - {}", pc.sk->get_ip(), strerror(errno));
+                    delete pc.sk;
+                }
             }
-            ilog("Attempting to connect to radio at {} on socket fd {}", ip, rad.sk->fd());
-
-            if (rad.sk->connect(ip, 8081, _conn_timeout) != 0)
+            else if (sweep_timer.elapsed() >= pc.deadline)
             {
-                ilog("Connection timeout to {} - no radio found", ip, strerror(errno));
-                delete rad.sk;
-                continue;
+                ilog("Connection timeout to {} - no radio found", pc.sk->get_ip());
+                delete pc.sk;
             }
-
-            if (!rad.sk->start())
+            else
             {
-                ilog("Could not start socket for {} on threaded fd: {}", ip, Threaded_Fd::error_string(rad.sk->error()));
-                delete rad.sk;
+                continue;
             }
-            ilog("Opened connection to radio at {} on socket fd {}", ip, rad.sk->fd());
-            rad.cur_cmd = cmd::ind::FREQ;
-            _radios.push_back(rad);
+            pending.erase(pending.begin() + i);
         }
     }
+
+    // Anything left pending means we were stopped part way through
+    for (size_t i = 0; i < pending.size(); ++i)
+        delete pending[i].sk;
+
+    sweep_timer.update();
+    ilog("Radio discovery of {} addresses complete in {} ms", size, sweep_timer.elapsed());
 }
 
 void Radio_Telnet::set_max_retry_count(uint8_t max_retry_count)
@@ -541,170 +960,254 @@ void Radio_Telnet::release()
     Subsystem::release();
     complete_scans = 0;
     _cur_cmd = 0;
+
+    // Everything queued goes out before the loggers (and their files) go away - closing them writes out anything they
+    // held back
+    auto liter = _loggers.begin();
+    while (liter != _loggers.end())
+    {
+        _log_writer->enqueue_close(&liter->second);
+        ++liter;
+    }
+    _log_writer->stop();
     _loggers.clear();
 
+    // Stop reconnecting first - it hands back sockets by radio
+    _reconnect->stop();
+    _reconnect_results.clear();
+
     while (!_radios.empty())
     {
-        delete _radios.back().sk;
+        Socket * sk = _radios.back().sk;
+        if (sk)
+            ilog("Socket buffers for {} - {}", sk->get_ip(), Threaded_Fd::buffer_stats_string(sk->buffer_stats()));
+        delete sk;
         _radios.pop_back();
     }
+    _telemetry.clear();
+    _history.clear();
+    _reactor->stop();
+}
+
+const char * _status_cstr(const CM300_Radio * rad, int32_t status)
+{
+    if (rad->is_tx())
+        return ptt_cstr(status);
+    return squelch_cstr(status);
 }
 
-bool _check_status_option(const Logger_Entry & logger_ent,
-                          const std::string & param_name,
-                          int32_t cur_status,
-                          int32_t prev_status,
-                          const CM300_Radio * rad)
+uint8_t _check_status_option(const Logger_Entry & logger_ent, uint8_t param, int32_t cur_status, int32_t prev_status, const CM300_Radio * rad)
 {
     const Logger_Options & le = logger_ent.loptions;
-    auto iter = le.item_options.find(param_name);
-    if (iter != le.item_options.end())
+    if (!le.enabled(param))
+        return 0;
+
+    const Log_Option_Group & opt = le.items[param];
+    bool cond_change = (opt.change.enabled && (cur_status != prev_status));
+
+    if (le.log_changes_to_status && cond_change)
     {
-        bool cond_change = (iter->second.change.enabled && (cur_status != prev_status));
+        const char * pm = LOG_PARAM_NAMES[param];
+        if (opt.title.enabled && !opt.title.val.empty())
+            pm = opt.title.val.c_str();
+
+        ilog("{} {} ({}) for logger {}: {} changed to {} (was {})",
+             rad->freq_mhz(),
+             rad->radio_type(),
+             rad->serial,
+             logger_ent.name,
+             pm,
+             _status_cstr(rad, cur_status),
+             _status_cstr(rad, prev_status));
+    }
 
-        if (le.log_changes_to_status && cond_change)
-        {
-            std::string pm(param_name);
-            if (iter->second.title.enabled && !iter->second.title.val.empty())
-                pm = iter->second.title.val;
-            std::string prev_string, cur_string;
-            if (rad->radio_type() == TX_STR)
-            {
-                prev_string = ptt_string(prev_status);
-                cur_string = ptt_string(cur_status);
-            }
-            else
-            {
-                prev_string = squelch_string(prev_status);
-                cur_string = squelch_string(cur_status);
-            }
+    bool cond_equal = (opt.equal.enabled && BITS_SET(opt.equal.val, cur_status));
+    return (cond_change ? TRIGGER_CHANGE : 0) | (cond_equal ? TRIGGER_LEVEL : 0);
+}
 
-            ilog("{} {} ({}) for logger {}: {} changed to {} (was {})",
-                 rad->freq_mhz,
-                 rad->radio_type(),
-                 rad->serial,
-                 logger_ent.name,
-                 pm,
-                 cur_string,
-                 prev_string);
-        }
+uint8_t _check_float_option(const Logger_Entry & logger_ent, uint8_t param, float cur_val, float prev_val, const CM300_Radio * rad)
+{
+    const Logger_Options & le = logger_ent.loptions;
+    if (!le.enabled(param))
+        return 0;
+
+    const Log_Option_Group & opt = le.items[param];
+    double change = std::abs(cur_val - prev_val);
+    double percent_change = change;
+    if (!DEQUALS(percent_change, 0.0, EPS))
+        percent_change = (change / std::abs(cur_val));
+    percent_change *= 100.0;
+
+    bool cond_change = (opt.change.enabled && (change > opt.change.val));
+    bool cond_percent_change = (opt.percent_change.enabled && (percent_change > opt.percent_change.val));
 
-        bool cond_equal = (iter->second.equal.enabled && BITS_SET(iter->second.equal.val, cur_status));
-        return cond_change || cond_equal;
+    if (le.log_changes_to_status && (cond_change || cond_percent_change))
+    {
+        const char * pm = LOG_PARAM_NAMES[param];
+        if (opt.title.enabled && !opt.title.val.empty())
+            pm = opt.title.val.c_str();
+        ilog("{} {} ({}) for logger {}: {} changed over log threshold to {} (was {} - change of {}%)",
+             rad->freq_mhz(),
+             rad->radio_type(),
+             rad->serial,
+             logger_ent.name,
+             pm,
+             cur_val,
+             prev_val,
+             percent_change);
     }
-    return false;
+
+    bool cond_less_than = (opt.less_than.enabled && (cur_val < opt.less_than.val));
+    bool cond_greater_than = (opt.greater_than.enabled && (cur_val > opt.greater_than.val));
+
+    bool cond_less_greater = cond_less_than || cond_greater_than;
+
+    if (opt.less_than.enabled && opt.greater_than.enabled && (opt.less_than.val > opt.greater_than.val))
+        cond_less_greater = cond_less_than && cond_greater_than;
+
+    return ((cond_change || cond_percent_change) ? TRIGGER_CHANGE : 0) | (cond_less_greater ? TRIGGER_LEVEL : 0);
 }
 
-bool _check_float_option(const Logger_Entry & logger_ent, const std::string & param_name, float cur_val, float prev_val, const CM300_Radio * rad)
+uint8_t _check_option(const Logger_Entry & logger_ent, uint8_t param, const CM300_Radio * cur, const Radio_Telemetry & tel, const Radio_Sample * prev)
 {
-    const Logger_Options & le = logger_ent.loptions;
-    auto iter = le.item_options.find(param_name);
-    if (iter != le.item_options.end())
+    float cur_val = tel.value(cur->row, param);
+    float prev_val = log_param_value(prev->tx, prev->rx, param);
+    if (log_param_is_status(param))
+        return _check_status_option(logger_ent, param, int32_t(cur_val), int32_t(prev_val), cur);
+    return _check_float_option(logger_ent, param, cur_val, prev_val, cur);
+}
+
+uint8_t Logger_Entry::evaluate_radio(size_t rind, const CM300_Radio & radio, const Radio_Telemetry & tel)
+{
+    const Radio_Sample * prev = &prev_state[rind];
+    const uint8_t * columns = loptions.columns.rx_columns;
+    uint8_t column_count = loptions.columns.rx_column_count;
+    if (radio.is_tx())
     {
-        double change = std::abs(cur_val - prev_val);
-        double percent_change = change;
-        if (!DEQUALS(percent_change, 0.0, EPS))
-            percent_change = (change / std::abs(cur_val));
-        percent_change *= 100.0;
+        columns = loptions.columns.tx_columns;
+        column_count = loptions.columns.tx_column_count;
+    }
 
-        bool cond_change = (iter->second.change.enabled && (change > iter->second.change.val));
-        bool cond_percent_change = (iter->second.percent_change.enabled && (percent_change > iter->second.percent_change.val));
+    // Always log on serial change or freq change
+    uint8_t triggers = 0;
+    if (radio.serial.compare(0, RADIO_SERIAL_SIZE - 1, prev->serial) != 0 || !DEQUALS(tel.freq_mhz[radio.row], prev->freq_mhz, EPS))
+        triggers |= TRIGGER_CHANGE;
 
-        if (le.log_changes_to_status && (cond_change || cond_percent_change))
-        {
-            std::string pm(param_name);
-            if (iter->second.title.enabled && !iter->second.title.val.empty())
-                pm = iter->second.title.val;
-            ilog("{} {} ({}) for logger {}: {} changed over log threshold to {} (was {} - change of {}%)",
-                 rad->freq_mhz,
-                 rad->radio_type(),
-                 rad->serial,
-                 logger_ent.name,
-                 pm,
-                 cur_val,
-                 prev_val,
-                 percent_change);
-        }
+    // Every column is checked so each change gets its message
+    for (uint8_t col = 0; col < column_count; ++col)
+        triggers |= _check_option(*this, columns[col], &radio, tel, prev);
+    return triggers;
+}
 
-        bool cond_less_than = (iter->second.less_than.enabled && (cur_val < iter->second.less_than.val));
-        bool cond_greater_than = (iter->second.greater_than.enabled && (cur_val > iter->second.greater_than.val));
+void Logger_Entry::evaluate_all(const Radio_Telemetry & tel, const Radio_History & history)
+{
+    uint32_t count = tel.size();
+    cached_triggers.assign(count, 0);
+    uint8_t * triggers = cached_triggers.data();
 
-        bool cond_less_greater = cond_less_than || cond_greater_than;
+    // Always log on freq change - serials are checked separately as they are strings
+    eval_value_change(tel.freq_mhz.data(), logged.freq_mhz.data(), EPS, count, triggers);
 
-        if (iter->second.less_than.enabled && iter->second.greater_than.enabled && (iter->second.less_than.val > iter->second.greater_than.val))
-            cond_less_greater = cond_less_than && cond_greater_than;
+    // Each column is one pass over all radios - tx columns only apply to transmitters and rx columns to the rest
+    const Log_Columns & cols = loptions.columns;
+    for (uint8_t col = 0; col < cols.tx_column_count + cols.rx_column_count; ++col)
+    {
+        bool tx_col = col < cols.tx_column_count;
+        uint8_t param = tx_col ? cols.tx_columns[col] : cols.rx_columns[col - cols.tx_column_count];
+        uint8_t kind = tx_col ? 1 : 0;
+        if (log_param_is_status(param))
+            eval_status_trigger(
+                loptions.status_triggers[param], status_column(tel, param), status_column(logged, param), tel.is_tx.data(), kind, count, triggers);
+        else
+            eval_float_trigger(
+                loptions.float_triggers[param], float_column(tel, param), float_column(logged, param), tel.is_tx.data(), kind, EPS, count, triggers);
 
-        return cond_change || cond_percent_change || cond_less_greater;
+        if ((loptions.hold_mask & (1u << param)) == 0)
+            continue;
+
+        uint32_t hold_ms = loptions.items[param].hold_ms.val;
+        int64_t now_ms = int64_t(util::monotonic_ms());
+        for (uint32_t row = 0; row < count; ++row)
+        {
+            if (tel.is_tx[row] != kind)
+                continue;
+            const Param_History * ph = history.get(row, param);
+            if (ph && ph->held(loptions.held[param], hold_ms, now_ms))
+                triggers[row] |= TRIGGER_LEVEL;
+        }
     }
-    return false;
 }
 
-void Logger_Entry::update_and_log_if_needed(const std::vector<CM300_Radio> & radios)
+void Logger_Entry::update_and_log_if_needed(const std::vector<CM300_Radio> & radios, const Radio_Telemetry & tel, const Radio_History & history)
 {
     ms_counter += edm.sys_timer()->dt();
     bool should_log = false;
 
     //ilog("mscounter: {}   loptions.period {}   radios size {}",ms_counter, loptions.period, radios.size());
-    if (ms_counter >= loptions.period)
+    if (prev_state.size() != radios.size())
+    {
+        ms_counter = 0;
+        reset_state(radios, tel);
+        should_log = true;
+    }
+    else if (ms_counter >= loptions.period)
     {
         ms_counter = 0;
 
-        for (int rind = 0; rind < radios.size(); ++rind)
-        {
-            CM300_Radio * prev = &prev_state[rind];
-            const CM300_Radio * cur = &radios[rind];
-            bool is_tx = (cur->radio_type() == TX_STR);
+        // Nothing needs looking at again unless some radio changed since the last check - radio i is telemetry row i.
+        // Held conditions can start holding with nothing changing so they are always checked.
+        bool changed = triggers_stale || (loptions.hold_mask != 0);
+        for (size_t rind = 0; rind < radios.size(); ++rind)
+            changed |= (checked_generation[rind] != tel.generation[rind]);
 
-            // Always log on serial change or freq change
-            should_log = should_log || (cur->serial != prev->serial) || !DEQUALS(cur->freq_mhz, prev->freq_mhz, EPS);
+        if (changed)
+        {
+            evaluate_all(tel, history);
 
-            if (loptions.log_changes_to_status)
+            // Serial changes, and status messages, only for the radios that actually changed
+            for (size_t rind = 0; rind < radios.size(); ++rind)
             {
-                if (is_tx)
-                {
-                    should_log = _check_status_option(*this, "ptt_status", cur->tx.ptt_status, prev->tx.ptt_status, cur) || should_log;
-                    should_log = _check_float_option(*this, "forward_power", cur->tx.forward_power, prev->tx.forward_power, cur) || should_log;
-                    should_log = _check_float_option(*this, "reverse_power", cur->tx.reverse_power, prev->tx.reverse_power, cur) || should_log;
-                    should_log = _check_float_option(*this, "vswr", cur->tx.vswr, prev->tx.vswr, cur) || should_log;
-                }
-                else
-                {
-                    should_log = _check_status_option(*this, "squelch_status", cur->rx.squelch_status, prev->rx.squelch_status, cur) || should_log;
-                    should_log = _check_float_option(*this, "agc", cur->rx.agc, prev->rx.agc, cur) || should_log;
-                    should_log = _check_float_option(*this, "line_level", cur->rx.line_level, prev->rx.line_level, cur) || should_log;
-                }
-            }
-            else
-            {
-                if (is_tx)
-                {
-                    should_log = should_log || _check_status_option(*this, "ptt_status", cur->tx.ptt_status, prev->tx.ptt_status, cur);
-                    should_log = should_log || _check_float_option(*this, "forward_power", cur->tx.forward_power, prev->tx.forward_power, cur);
-                    should_log = should_log || _check_float_option(*this, "reverse_power", cur->tx.reverse_power, prev->tx.reverse_power, cur);
-                    should_log = should_log || _check_float_option(*this, "vswr", cur->tx.vswr, prev->tx.vswr, cur);
-                }
-                else
-                {
-                    should_log = should_log || _check_status_option(*this, "squelch_status", cur->rx.squelch_status, prev->rx.squelch_status, cur);
-                    should_log = should_log || _check_float_option(*this, "agc", cur->rx.agc, prev->rx.agc, cur);
-                    should_log = should_log || _check_float_option(*this, "line_level", cur->rx.line_level, prev->rx.line_level, cur);
-                }
+                if (!triggers_stale && checked_generation[rind] == tel.generation[rind])
+                    continue;
+                if (radios[rind].serial.compare(0, RADIO_SERIAL_SIZE - 1, prev_state[rind].serial) != 0)
+                    cached_triggers[rind] |= TRIGGER_CHANGE;
+                if (loptions.log_changes_to_status && (cached_triggers[rind] & TRIGGER_CHANGE))
+                    evaluate_radio(rind, radios[rind], tel);
             }
+            checked_generation = tel.generation;
+            triggers_stale = false;
         }
-    }
-    else if (prev_state.size() != radios.size())
-    {
-        ms_counter = 0;
-        should_log = true;
+
+        for (size_t rind = 0; rind < cached_triggers.size(); ++rind)
+            should_log = should_log || (cached_triggers[rind] != 0);
     }
 
     if (should_log)
     {
-        prev_state = radios;
+        // The logged state now matches the radios so nothing has changed from it - conditions on the values still hold
+        snapshot_state(radios, tel);
+        for (size_t rind = 0; rind < cached_triggers.size(); ++rind)
+            cached_triggers[rind] &= ~TRIGGER_CHANGE;
         write_radio_data_to_file();
     }
 }
 
+void Logger_Entry::reset_state(const std::vector<CM300_Radio> & radios, const Radio_Telemetry & tel)
+{
+    snapshot_state(radios, tel);
+    checked_generation.assign(radios.size(), 0);
+    cached_triggers.assign(radios.size(), 0);
+    triggers_stale = true;
+}
+
+void Logger_Entry::snapshot_state(const std::vector<CM300_Radio> & radios, const Radio_Telemetry & tel)
+{
+    prev_state.resize(radios.size());
+    for (size_t rind = 0; rind < radios.size(); ++rind)
+        prev_state[rind] = Radio_Sample(radios[rind]);
+    logged = tel;
+}
+
 void Radio_Telnet::_simulated_radios_update()
 {
     static double counter = 0;
@@ -737,9 +1240,9 @@ void Radio_Telnet::_simulated_radios_update()
         // If the corresponding transmitter is not keyed, then close the randomly generated squelch break previously opened
         if (rx_squelch_break_ind != -1 && ((rx_squelch_break_ind != (tx_ind - 1)) || (_radios.size() == 1)))
         {
-            _radios[rx_squelch_break_ind].rx.squelch_status = SQUELCH_CLOSED;
-            _radios[rx_squelch_break_ind].rx.agc = 1.61;
-            _radios[rx_squelch_break_ind].rx.line_level = -46.0;
+            _telemetry.squelch_status[rx_squelch_break_ind] = SQUELCH_CLOSED;
+            _telemetry.agc[rx_squelch_break_ind] = 1.61;
+            _telemetry.line_level[rx_squelch_break_ind] = -46.0;
             rx_squelch_break_ind = -1;
         }
 
@@ -751,9 +1254,9 @@ void Radio_Telnet::_simulated_radios_update()
             {
                 rx_squelch_break_ind = (rand() % _radios.size() / 2) * 2;
             } while ((rx_squelch_break_ind == (tx_ind - 1)) && (_radios.size() > 1));
-            _radios[rx_squelch_break_ind].rx.squelch_status = SQUELCH_OPEN;
-            _radios[rx_squelch_break_ind].rx.agc = 2.2;
-            _radios[rx_squelch_break_ind].rx.line_level = -8.0;
+            _telemetry.squelch_status[rx_squelch_break_ind] = SQUELCH_OPEN;
+            _telemetry.agc[rx_squelch_break_ind] = 2.2;
+            _telemetry.line_level[rx_squelch_break_ind] = -8.0;
             counter_rx_squelch = 0;
         }
 
@@ -766,28 +1269,28 @@ void Radio_Telnet::_simulated_radios_update()
             if (prev_tx_index < 0)
                 prev_tx_index = _radios.size() - 1;
 
-            cur->tx.ptt_status = CUR_PTT_STATE;
-            cur->tx.forward_power = 12;
-            cur->tx.vswr = 1.0;
-            cur_rx->rx.squelch_status = SQUELCH_OPEN;
-            cur_rx->rx.line_level = -8;
-            cur_rx->rx.agc = 2.6;
+            _telemetry.ptt_status[cur->row] = CUR_PTT_STATE;
+            _telemetry.forward_power[cur->row] = 12;
+            _telemetry.vswr[cur->row] = 1.0;
+            _telemetry.squelch_status[cur_rx->row] = SQUELCH_OPEN;
+            _telemetry.line_level[cur_rx->row] = -8;
+            _telemetry.agc[cur_rx->row] = 2.6;
 
             if (prev_tx_index != tx_ind)
             {
                 CM300_Radio * prev_tx = &_radios[prev_tx_index];
                 CM300_Radio * prev_rx = prev_tx - 1;
 
-                prev_tx->tx.ptt_status = PTT_OFF;
-                prev_tx->tx.forward_power = 0;
-                prev_tx->tx.vswr = -1.0;
+                _telemetry.ptt_status[prev_tx->row] = PTT_OFF;
+                _telemetry.forward_power[prev_tx->row] = 0;
+                _telemetry.vswr[prev_tx->row] = -1.0;
 
                 // Only turn off the previous RX squelch if it isn't the random one we opened squelch on this round
                 if ((prev_tx_index - 1) != rx_squelch_break_ind)
                 {
-                    prev_rx->rx.squelch_status = SQUELCH_CLOSED;
-                    prev_rx->rx.line_level = -46.0;
-                    prev_rx->rx.agc = 1.61;
+                    _telemetry.squelch_status[prev_rx->row] = SQUELCH_CLOSED;
+                    _telemetry.line_level[prev_rx->row] = -46.0;
+                    _telemetry.agc[prev_rx->row] = 1.61;
                 }
             }
 
@@ -795,9 +1298,9 @@ void Radio_Telnet::_simulated_radios_update()
             ++counter_high_vswr;
             if (counter_high_vswr == _simulated_high_vswr_period_count)
             {
-                cur->tx.forward_power = 12.0;
-                cur->tx.reverse_power = 2.2041;
-                cur->tx.vswr = 2.5;
+                _telemetry.forward_power[cur->row] = 12.0;
+                _telemetry.reverse_power[cur->row] = 2.2041;
+                _telemetry.vswr[cur->row] = 2.5;
                 counter_high_vswr = 0;
             }
 
@@ -811,19 +1314,23 @@ void Radio_Telnet::_simulated_radios_update()
             }
         }
 
+        // Simulated values are set directly rather than parsed - just count every radio as changed
+        for (uint32_t i = 0; i < _telemetry.size(); ++i)
+            _telemetry.touch(i);
         counter = 0;
     }
+    edm.schedule_update(_simulation_period - counter + 1);
 }
 
 void Radio_Telnet::update()
 {
     bool complete_scan = true;
 
+    _update_reconnected();
+
     auto iter = _radios.begin();
     while (iter != _radios.end())
     {
-        CM300_Radio prev = *iter;
-
         _update(&(*iter));
         _update_closed(&(*iter));
 
@@ -846,14 +1353,20 @@ void Radio_Telnet::update()
     if (_simulate_radios)
         _simulated_radios_update();
 
-    if (all_radios_init && _logging)
+    _history.update(_telemetry);
+
+    auto liter = _loggers.begin();
+    while (liter != _loggers.end())
     {
-        auto liter = _loggers.begin();
-        while (liter != _loggers.end())
+        Logger_Entry & le = liter->second;
+        if (all_radios_init && _logging)
         {
-            liter->second.update_and_log_if_needed(_radios);
-            ++liter;
+            le.update_and_log_if_needed(_radios, _telemetry, _history);
+            // A period of 0 logs on every update, which new radio data already wakes us for
+            if (le.loptions.period > 0)
+                edm.schedule_update(double(le.loptions.period) - le.ms_counter);
         }
+        ++liter;
     }
 
     if (complete_scan)
@@ -868,7 +1381,7 @@ void Radio_Telnet::update()
         auto liter = _loggers.begin();
         while (liter != _loggers.end())
         {
-            liter->second.prev_state = _radios;
+            liter->second.reset_state(_radios, _telemetry);
             liter->second.write_headers_to_file();
             liter->second.write_radio_data_to_file();
             ++liter;
@@ -878,184 +1391,322 @@ void Radio_Telnet::update()
     _update_usb_drive_status();
 }
 
+void Radio_Telnet::_close_log_files()
+{
+    // Open files would keep the drive busy and new ones need to go wherever dir_path points now - wait for the writer
+    // so nothing is still open (or about to be) when the drive is (un)mounted or the loggers are replaced
+    auto liter = _loggers.begin();
+    while (liter != _loggers.end())
+    {
+        _log_writer->enqueue_close(&liter->second);
+        ++liter;
+    }
+    _log_writer->drain();
+    ilog("Csv writer - {}", Log_Writer::stats_string(_log_writer->stats()));
+}
+
 void Radio_Telnet::_update_usb_drive_status()
 {
     static bool thmb_drive_prev = edm.usb_drive_detected();
     bool thmb_drive_cur = edm.usb_drive_detected();
     if (thmb_drive_prev != thmb_drive_cur)
     {
+        // Mounting takes seconds - the drive worker does it while we keep polling the radios and logging to wherever
+        // the loggers are logging now, and the loggers are only switched over once it's done
         if (thmb_drive_cur)
         {
-            _reset_sim = true;
-            complete_scans = 0;
-
-            ilog("USB drive detected - trying to reload the config from {}", USB_DRIVE_MNT_DIR);
-            edm.mount_drive();
-
-            Config_File cfg;
-            edm.load_config(&cfg);
-
-            // Save previous values
-            bool sim_radios_prev = _simulate_radios;
-            int8_t prev_ip_up = _ip_ub;
-            int8_t prev_ip_low = _ip_lb;
-
-            _loggers.clear();
-            _set_options_from_config_file(&cfg);
-
-            if (prev_ip_up != _ip_ub || prev_ip_low != _ip_lb || _simulate_radios != sim_radios_prev)
-            {
-                ilog("Config file found on {} and it required reinitializing radios", USB_DRIVE_MNT_DIR);
-                complete_scans = 0;
-                _cur_cmd = 0;
-                while (!_radios.empty())
-                {
-                    delete _radios.back().sk;
-                    _radios.pop_back();
-                }
-                _init_radios();
-            }
-            else
-            {
-                ilog("No need to reinitialize the radios - {} loggers being reinitialized", _loggers.size());
-                // Setup the loggers prev state to now!
-                auto liter = _loggers.begin();
-                while (liter != _loggers.end())
-                {
-                    liter->second.prev_state = _radios;
-                    liter->second.write_headers_to_file();
-                    liter->second.write_radio_data_to_file();
-                    ++liter;
-                }
-            }
+            ilog("USB drive detected - mounting it and reloading the config from {}", USB_DRIVE_MNT_DIR);
+            edm.drive_worker()->mount([this](Drive_Job * job) { _drive_mounted(job); });
         }
         else
         {
+            // The files on the drive are gone - queue the new files' headers and hold on to them and anything logged
+            // after until the mount point is gone and they can be opened in the backup dir
             ilog("USB drive removed - unmounting /dev/sda1 from {}", USB_DRIVE_MNT_DIR);
-            edm.unmount_drive();
-
-            // Setup the loggers prev state to now!
-            auto liter = _loggers.begin();
-            while (liter != _loggers.end())
-            {
-                liter->second.prev_state = _radios;
-                liter->second.write_headers_to_file();
-                liter->second.write_radio_data_to_file();
-                ++liter;
-            }
+            _close_log_files();
+            _log_writer->hold(true);
+            _reset_loggers();
+            edm.drive_worker()->unmount([this](Drive_Job * job) { _drive_unmounted(job); });
         }
     }
     thmb_drive_prev = thmb_drive_cur;
 }
 
-void _handle_option_header(const Logger_Options & options, std::vector<std::string> & cur_row, const std::string & param)
+void Radio_Telnet::_drive_mounted(Drive_Job * job)
 {
-    auto iter = options.item_options.find(param);
-    if (iter != options.item_options.end())
+    // Pulled out again while it was mounting - its unmount is already queued behind us
+    if (!edm.usb_drive_detected())
     {
-        std::string title(param);
-        if (iter->second.title.enabled)
-            title = iter->second.title.val;
-        cur_row.push_back(title);
+        ilog("USB drive was removed before it finished mounting - not reloading the config");
+        return;
     }
+    _reload_config(job->cfg);
 }
 
-std::string Logger_Entry::get_header()
+void Radio_Telnet::_reload_config(Config_File * cfg)
 {
-    std::string first_row;
-    std::string second_row;
+    double start_ms = util::monotonic_ms();
 
-    for (int i = 0; i < prev_state.size(); ++i)
-    {
-        std::vector<std::string> cur_row;
+    // Save previous values
+    bool sim_radios_prev = _simulate_radios;
+    int32_t prev_ip_up = _ip_ub;
+    int32_t prev_ip_low = _ip_lb;
+
+    std::unordered_map<std::string, Logger_Entry> loggers;
+    _set_options_from_config_file(cfg, &loggers);
+    _reconnect->set_config(_reconnect_config(), _socket_buffers);
 
-        CM300_Radio * rad = &prev_state[i];
-        if (rad->radio_type() == TX_STR)
+    if (_simulate_radios != sim_radios_prev || (_simulate_radios && (prev_ip_up != _ip_ub || prev_ip_low != _ip_lb)))
+    {
+        // Nothing to keep going between real and simulated radios
+        ilog("Config file found on {} and it required reinitializing radios", USB_DRIVE_MNT_DIR);
+        _reset_sim = true;
+        complete_scans = 0;
+        _cur_cmd = 0;
+        while (!_radios.empty())
         {
-            _handle_option_header(loptions, cur_row, "ptt_status");
-            _handle_option_header(loptions, cur_row, "forward_power");
-            _handle_option_header(loptions, cur_row, "reverse_power");
-            _handle_option_header(loptions, cur_row, "vswr");
+            _remove_radio(&_radios.back());
+            _radios.pop_back();
         }
-        else if (rad->radio_type() == RX_STR)
+        _telemetry.clear();
+        _history.clear();
+        _init_radios();
+    }
+    else if (prev_ip_up != _ip_ub || prev_ip_low != _ip_lb)
+    {
+        _update_radio_range(prev_ip_low, prev_ip_up);
+    }
+
+    // After the radios - if they are being rebuilt new loggers have to wait for them rather than writing a header and
+    // row for the old ones
+    _update_loggers(loggers);
+    ilog("Reloaded config from {} in {:.1f} ms", USB_DRIVE_MNT_DIR, util::monotonic_ms() - start_ms);
+}
+
+Reconnect_Config Radio_Telnet::_reconnect_config()
+{
+    Reconnect_Config rcfg;
+    rcfg.min_delay_ms = _reconnect_min_delay_ms;
+    rcfg.max_delay_ms = _reconnect_max_delay_ms;
+    rcfg.max_attempts = _max_retry_count;
+    rcfg.timeout = _conn_timeout;
+    return rcfg;
+}
+
+void Radio_Telnet::_update_loggers(std::unordered_map<std::string, Logger_Entry> & loggers)
+{
+    // Loggers whose settings didn't change keep their state and open files - the rest are closed, and the writer
+    // drained so it's done with them, before they're replaced
+    bool closing = false;
+    auto liter = _loggers.begin();
+    while (liter != _loggers.end())
+    {
+        auto fiter = loggers.find(liter->first);
+        if (fiter == loggers.end() || fiter->second.cfg_signature != liter->second.cfg_signature)
         {
-            _handle_option_header(loptions, cur_row, "squelch_status");
-            _handle_option_header(loptions, cur_row, "agc");
-            _handle_option_header(loptions, cur_row, "line_level");
+            _log_writer->enqueue_close(&liter->second);
+            closing = true;
         }
         else
         {
-            wlog("Unknown Radio Type (serial: {} freq: {})", rad->serial, rad->freq_mhz);
+            // A file that fell back to the backup dir can go where it belongs now the drive is mounted
+            _log_writer->enqueue_recheck_dir(&liter->second);
         }
+        ++liter;
+    }
+    if (closing)
+        _log_writer->drain();
 
-        for (int i = 0; i < cur_row.size(); ++i)
+    uint32_t kept = 0, removed = 0;
+    liter = _loggers.begin();
+    while (liter != _loggers.end())
+    {
+        auto fiter = loggers.find(liter->first);
+        if (fiter != loggers.end() && fiter->second.cfg_signature == liter->second.cfg_signature)
         {
-            if (i == 0)
-                first_row += NUM_2_STR(rad->freq_mhz, 3) + " " + rad->radio_range() + " " + rad->radio_type() + " (" + rad->serial + ")";
-            first_row += ",";
-            second_row += cur_row[i] + ",";
+            loggers.erase(fiter);
+            ++kept;
+            ++liter;
+            continue;
         }
+        ++removed;
+        liter = _loggers.erase(liter);
     }
-    if (!first_row.empty())
-    {
-        first_row.pop_back();
-        first_row = ",," + first_row;
-    }
-    if (!second_row.empty())
+
+    // What's left is new or changed - if the radios are all up they start logging now, otherwise they are set up with
+    // the rest once they are
+    auto niter = loggers.begin();
+    while (niter != loggers.end())
     {
-        second_row.pop_back();
-        second_row = "Time (h:m:s), Elapsed (s)," + second_row;
+        Logger_Entry & le = _loggers.emplace(niter->first, niter->second).first->second;
+        if (all_radios_init)
+        {
+            le.reset_state(_radios, _telemetry);
+            le.write_headers_to_file();
+            le.write_radio_data_to_file();
+        }
+        ++niter;
     }
-    return first_row + "\n" + second_row;
+    ilog("Loggers reloaded - {} unchanged, {} removed or replaced, {} started", kept, removed, loggers.size());
 }
 
-std::string Logger_Entry::get_row()
+void Radio_Telnet::_update_radio_range(int32_t prev_lb, int32_t prev_ub)
 {
-    std::string row;
+    ilog("Radio ip range changed from {} - {} to {} - {}", prev_lb, prev_ub, _ip_lb, _ip_ub);
 
-    for (int i = 0; i < prev_state.size(); ++i)
+    // Only the addresses new to the range are scanned - radios still in range keep their connection (or their place
+    // with the reconnect service)
+    std::vector<int32_t> hosts;
+    for (int32_t host = _ip_lb; host <= _ip_ub; ++host)
     {
-        std::vector<std::string> cur_row;
-
-        CM300_Radio * rad = &prev_state[i];
-        if (rad->radio_type() == TX_STR)
+        if (host < prev_lb || host > prev_ub)
+            hosts.push_back(host);
+    }
+    std::vector<Socket *> found;
+    _discover_radios(hosts, found);
+
+    std::map<std::string, size_t> prev_radios;
+    for (size_t i = 0; i < _radios.size(); ++i)
+        prev_radios[_radios[i].ip] = i;
+
+    // Rebuild in address order with each kept radio's telemetry row copied over
+    std::vector<CM300_Radio> radios;
+    Radio_Telemetry telemetry;
+    size_t found_ind = 0;
+    for (int32_t host = _ip_lb; host <= _ip_ub; ++host)
+    {
+        std::string ip = RADIO_IP_PREFIX + std::to_string(host);
+        auto fiter = prev_radios.find(ip);
+        if (fiter != prev_radios.end())
         {
-            if (MAP_CONTAINS(loptions.item_options, "ptt_status"))
-                cur_row.push_back(rad->tx.ptt_string());
-            if (MAP_CONTAINS(loptions.item_options, "forward_power"))
-                cur_row.push_back(NUM_2_STR(rad->tx.forward_power, 2));
-            if (MAP_CONTAINS(loptions.item_options, "reverse_power"))
-                cur_row.push_back(NUM_2_STR(rad->tx.reverse_power, 2));
-            if (MAP_CONTAINS(loptions.item_options, "vswr"))
-                cur_row.push_back(NUM_2_STR(rad->tx.vswr, 2));
+            CM300_Radio rad = _radios[fiter->second];
+            rad.row = telemetry.add_row(_telemetry, rad.row);
+            radios.push_back(rad);
+            prev_radios.erase(fiter);
         }
-        else if (rad->radio_type() == RX_STR)
+        else if (found_ind < hosts.size() && hosts[found_ind] == host)
         {
-            if (MAP_CONTAINS(loptions.item_options, "squelch_status"))
-                cur_row.push_back(rad->rx.squelch_string());
-            if (MAP_CONTAINS(loptions.item_options, "agc"))
-                cur_row.push_back(NUM_2_STR(rad->rx.agc, 2));
-            if (MAP_CONTAINS(loptions.item_options, "line_level"))
-                cur_row.push_back(NUM_2_STR(rad->rx.line_level, 2));
+            CM300_Radio rad;
+            Socket * sk = found[found_ind];
+            if (sk && _start_radio(sk, &rad))
+            {
+                rad.row = telemetry.add_row();
+                radios.push_back(rad);
+            }
         }
-        for (int i = 0; i < cur_row.size(); ++i)
-            row += cur_row[i] + ",";
+        if (found_ind < hosts.size() && hosts[found_ind] == host)
+            ++found_ind;
+    }
+
+    // Whatever is left is out of range now
+    auto riter = prev_radios.begin();
+    while (riter != prev_radios.end())
+    {
+        ilog("Radio at {} is out of the new ip range - dropping it", riter->first);
+        _remove_radio(&_radios[riter->second]);
+        ++riter;
+    }
+
+    _radios.swap(radios);
+    _telemetry = telemetry;
+
+    // The loggers are set up again once any new radios are initialized - rows have moved so the history starts over
+    initialized_radios.clear();
+    for (size_t i = 0; i < _radios.size(); ++i)
+    {
+        _radios[i].telemetry = &_telemetry;
+        if (_radios[i].initialized())
+            initialized_radios.insert(&_radios[i]);
+    }
+    all_radios_init = false;
+    complete_scans = 0;
+    _history.clear();
+}
+
+void Radio_Telnet::_remove_radio(CM300_Radio * radio)
+{
+    if (radio->sk)
+    {
+        delete radio->sk;
+        radio->sk = nullptr;
+    }
+    else if (!radio->ip.empty())
+    {
+        _reconnect->cancel(radio->ip);
+    }
+}
+
+CM300_Radio * Radio_Telnet::_find_radio(const std::string & ip)
+{
+    for (size_t i = 0; i < _radios.size(); ++i)
+    {
+        if (_radios[i].ip == ip)
+            return &_radios[i];
+    }
+    return nullptr;
+}
+
+void Radio_Telnet::_drive_unmounted(Drive_Job *)
+{
+    _log_writer->hold(false);
+}
+
+void Radio_Telnet::_reset_loggers()
+{
+    // Setup the loggers prev state to now!
+    auto liter = _loggers.begin();
+    while (liter != _loggers.end())
+    {
+        liter->second.reset_state(_radios, _telemetry);
+        liter->second.write_headers_to_file();
+        liter->second.write_radio_data_to_file();
+        ++liter;
+    }
+}
+
+std::string Logger_Entry::get_header(const Radio_Sample * samples, uint32_t count)
+{
+    std::string first_row;
+    std::string second_row;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const Radio_Sample * rad = &samples[i];
+        if (!rad->is_tx() && !rad->is_rx())
+            wlog("Unknown Radio Type (serial: {} freq: {})", rad->serial, rad->freq_mhz);
+        csv::append_radio_header(loptions.columns, rad->serial, rad->freq_mhz, &first_row, &second_row);
     }
+    return csv::finish_header(&first_row, &second_row);
+}
+
+void Logger_Entry::get_row(const Radio_Sample * samples, uint32_t count, time_t wall_time, double elapsed_s, std::string * row)
+{
+    row->clear();
+    csv::append_time(wall_time, elapsed_s, row);
+    size_t prefix_size = row->size();
 
-    if (!row.empty())
+    for (uint32_t i = 0; i < count; ++i)
     {
-        row.pop_back();
-        row = util::get_current_time_string() + "," + NUM_2_STR(edm.sys_timer()->elapsed() / 1000.0, 2) + "," + row;
+        const Radio_Sample * rad = &samples[i];
+        uint8_t column_count = 0;
+        const uint8_t * columns = loptions.columns.for_serial(rad->serial, &column_count);
+        for (uint8_t col = 0; col < column_count; ++col)
+            csv::append_value(columns[col], log_param_value(rad->tx, rad->rx, columns[col]), row);
     }
-    return row;
+
+    // No columns means no row at all
+    if (row->size() == prefix_size)
+        row->clear();
 }
 
-std::string Logger_Entry::get_fname()
+std::string Logger_Entry::get_fname_base()
 {
+    // Called from the writer thread - no localtime
     time_t t = time(nullptr);
-    tm * ltm = localtime(&t);
+    tm ltm;
+    localtime_r(&t, &ltm);
 
-    std::string fname = name + " (" + util::formatted_date(ltm) + ").csv";
+    std::string fname = name + " (" + util::formatted_date(&ltm) + ")";
     if (!loptions.dir_path.empty())
     {
         if (loptions.dir_path.back() != '/')
@@ -1065,64 +1716,238 @@ std::string Logger_Entry::get_fname()
     return fname;
 }
 
+const char * Logger_Entry::get_fname_extension() const
+{
+    if (loptions.format == LOG_FORMAT_BINARY)
+        return BINARY_LOG_EXTENSION;
+    else if (loptions.format == LOG_FORMAT_SERIES)
+        return SERIES_FILE_EXTENSION;
+    return ".csv";
+}
+
+bool Logger_Entry::file_expired(time_t now) const
+{
+    return now >= file_day_end || (max_file_size > 0 && file->size() >= max_file_size);
+}
+
 bool Logger_Entry::write_headers_to_file()
 {
-    std::ofstream output;
-    std::string fname = get_fname();
-    output.open(fname, std::ios::out | std::ios::app);
-    if (output.is_open())
+    return writer->enqueue(this, Log_Record::Header, prev_state);
+}
+
+bool Logger_Entry::write_radio_data_to_file()
+{
+    return writer->enqueue(this, Log_Record::Row, prev_state);
+}
+
+bool Logger_Entry::write_header_now(const Radio_Sample * samples, uint32_t count, int64_t wall_ms, double elapsed_s)
+{
+    time_t wall_time = wall_ms / 1000;
+    if (loptions.format == LOG_FORMAT_BINARY)
+        return write_binary_header_now(samples, count, wall_time, elapsed_s);
+    else if (loptions.format == LOG_FORMAT_SERIES)
+        return open_file();
+    if (!open_file())
+        return false;
+    return file->write_line(get_header(samples, count));
+}
+
+bool Logger_Entry::write_row_now(const Radio_Sample * samples, uint32_t count, int64_t wall_ms, double elapsed_s)
+{
+    time_t wall_time = wall_ms / 1000;
+    if (loptions.format == LOG_FORMAT_BINARY)
+        return write_binary_row_now(samples, count, wall_time, elapsed_s);
+    else if (loptions.format == LOG_FORMAT_SERIES)
+        return write_series_row_now(samples, count, wall_ms);
+
+    bool created = false;
+    if (!open_file(&created))
+        return false;
+    if (created)
+        file->write_line(get_header(samples, count));
+    get_row(samples, count, wall_time, elapsed_s, &row_buffer);
+    return file->write_line(row_buffer);
+}
+
+void Logger_Entry::append_binary_schema(const Radio_Sample * samples, uint32_t count, uint8_t flags, time_t wall_time, double elapsed_s)
+{
+    bin_schema.flags = flags;
+    bin_schema.columns = loptions.columns;
+    bin_schema.radios.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
     {
-        ilog("Successfully opened {} for logging", fname);
-        output << get_header() << "\n";
-        output.close();
-        return true;
+        Binary_Log_Radio & rad = bin_schema.radios[i];
+        memset(rad.serial, 0, BLOG_SERIAL_SIZE);
+        strncpy(rad.serial, samples[i].serial, BLOG_SERIAL_SIZE - 1);
+        rad.freq_mhz = samples[i].freq_mhz;
     }
-    else
+    blog::append_schema(&bin_schema, wall_time, elapsed_s, &row_buffer);
+    bin_schema_valid = true;
+}
+
+bool Logger_Entry::write_binary_header_now(const Radio_Sample * samples, uint32_t count, time_t wall_time, double elapsed_s)
+{
+    if (!open_file())
+        return false;
+    row_buffer.clear();
+    append_binary_schema(samples, count, BLOG_FLAG_HEADER, wall_time, elapsed_s);
+    return file->write(row_buffer.data(), row_buffer.size());
+}
+
+bool Logger_Entry::write_binary_row_now(const Radio_Sample * samples, uint32_t count, time_t wall_time, double elapsed_s)
+{
+    bool created = false;
+    if (!open_file(&created))
+        return false;
+    row_buffer.clear();
+
+    // Records are only decodable against the schema before them - write a new one if the radios don't match it
+    bool schema_ok = bin_schema_valid && !created && bin_schema.radios.size() == count;
+    for (uint32_t i = 0; schema_ok && i < count; ++i)
+        schema_ok = strncmp(bin_schema.radios[i].serial, samples[i].serial, BLOG_SERIAL_SIZE) == 0;
+    if (!schema_ok)
+        append_binary_schema(samples, count, created ? BLOG_FLAG_HEADER : 0, wall_time, elapsed_s);
+
+    // A schema resets the clock so the deltas always fit after one
+    if (!blog::append_record_start(&bin_schema, wall_time, elapsed_s, &row_buffer))
     {
-        ilog("Could not open {}: {}", fname, strerror(errno));
-        if (!loptions.dir_path.empty())
-        {
-            ilog("Trying to open file in {} instead of {}", _backup_log_dir, loptions.dir_path);
-            std::string saved = loptions.dir_path;
-            loptions.dir_path = _backup_log_dir;
-            bool result = write_headers_to_file();
-            loptions.dir_path = saved;
-            return result;
-        }
+        append_binary_schema(samples, count, 0, wall_time, elapsed_s);
+        blog::append_record_start(&bin_schema, wall_time, elapsed_s, &row_buffer);
     }
-    return false;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const Radio_Sample * rad = &samples[i];
+        uint8_t column_count = 0;
+        const uint8_t * columns = loptions.columns.for_serial(rad->serial, &column_count);
+        for (uint8_t col = 0; col < column_count; ++col)
+            blog::append_value(columns[col], log_param_value(rad->tx, rad->rx, columns[col]), &row_buffer);
+    }
+    return file->write(row_buffer.data(), row_buffer.size());
 }
 
-bool Logger_Entry::write_radio_data_to_file()
+bool Logger_Entry::write_series_row_now(const Radio_Sample * samples, uint32_t count, int64_t wall_ms)
 {
-    bool write_header = false;
-    std::ofstream output;
-    std::string fname = get_fname();
-
-    if (!util::path_exists(fname))
-        write_header = true;
+    // Chunks go in the file they were started in - seal them before the file changes over
+    row_buffer.clear();
+    if (file->is_open() && file_expired(time(nullptr)))
+    {
+        series->seal_all(&row_buffer);
+        write_series_chunks();
+    }
+    if (!open_file())
+        return false;
 
-    output.open(fname, std::ios::out | std::ios::app);
-    if (output.is_open())
+    // Every column of every radio is its own series - most points just go in to the series' open chunk
+    row_buffer.clear();
+    for (uint32_t i = 0; i < count; ++i)
     {
-        if (write_header)
-            output << get_header() << "\n";
+        const Radio_Sample * rad = &samples[i];
+        uint8_t column_count = 0;
+        const uint8_t * columns = loptions.columns.for_serial(rad->serial, &column_count);
+        for (uint8_t col = 0; col < column_count; ++col)
+            series->append(rad->serial, columns[col], wall_ms, log_param_value(rad->tx, rad->rx, columns[col]), &row_buffer);
+    }
+    series->seal_expired(wall_ms, &row_buffer);
+    return write_series_chunks();
+}
 
-        output << get_row() << "\n";
-        output.close();
+bool Logger_Entry::write_series_chunks()
+{
+    if (row_buffer.empty())
+        return true;
+    return file->write(row_buffer.data(), row_buffer.size());
+}
+
+bool Logger_Entry::open_file(bool * created)
+{
+    // The file name has the date in it - only look at it again when the day rolls over or the file fills up
+    time_t now = time(nullptr);
+    if (file->is_open() && !file_expired(now))
+        return true;
+
+    // A new day starts from part 1 - a full part moves on to the next. Parts that are already full or compressed (ie
+    // from before a restart) are skipped.
+    if (now >= file_day_end)
+        file_part = 1;
+    else if (file->is_open())
+        ++file_part;
+    file->close();
+
+    std::string fname;
+    file_part = claim_log_part(archiver, this, get_fname_base(), get_fname_extension(), file_part, max_file_size, &fname);
+    if (file->open(fname, created))
+    {
+        ilog("Successfully opened {} for logging", fname);
+        file_day_end = util::next_local_midnight(now);
+        bin_schema_valid = false;
         return true;
     }
-    else if (!loptions.dir_path.empty())
+
+    ilog("Could not open {}: {}", fname, strerror(errno));
+    if (archiver)
+        archiver->set_active(this, std::string());
+    if (!loptions.dir_path.empty())
     {
+        ilog("Trying to open file in {} instead of {}", _backup_log_dir, loptions.dir_path);
         std::string saved = loptions.dir_path;
         loptions.dir_path = _backup_log_dir;
-        bool result = write_radio_data_to_file();
+        bool result = open_file(created);
         loptions.dir_path = saved;
         return result;
     }
     return false;
 }
 
+void Logger_Entry::update_file()
+{
+    if (!file->is_open())
+        return;
+
+    // A stat per flush period is plenty to notice the file going away
+    double now = util::monotonic_ms();
+    if (now - last_stale_check_ms >= file->config().flush_period_ms)
+    {
+        last_stale_check_ms = now;
+        if (file->stale())
+        {
+            ilog("Log file {} was removed or its drive was swapped - reopening on the next write", file->fname());
+            file->close();
+            if (archiver)
+                archiver->set_active(this, std::string());
+            return;
+        }
+    }
+
+    // Chunks that have been open for the chunk span get written even if they aren't full
+    if (series)
+    {
+        row_buffer.clear();
+        series->seal_expired(util::wall_ms(), &row_buffer);
+        write_series_chunks();
+    }
+    file->update();
+}
+
+bool Logger_Entry::in_backup_dir() const
+{
+    if (!file->is_open() || loptions.dir_path.empty() || loptions.dir_path == _backup_log_dir)
+        return false;
+    return file->fname().compare(0, _backup_log_dir.size() + 1, _backup_log_dir + "/") == 0;
+}
+
+void Logger_Entry::close_file()
+{
+    if (series && series->pending() > 0 && open_file())
+    {
+        row_buffer.clear();
+        series->seal_all(&row_buffer);
+        write_series_chunks();
+    }
+    file->close();
+    if (archiver)
+        archiver->set_active(this, std::string());
+}
 void Radio_Telnet::_update(CM300_Radio * radio)
 {
     if (!radio->sk)
@@ -1131,32 +1956,48 @@ void Radio_Telnet::_update(CM300_Radio * radio)
         return;
     }
 
-    uint32_t cnt = radio->sk->read(radio->response_buffer + radio->buffer_offset, BUFFER_SIZE - radio->buffer_offset);
-    radio->buffer_offset += cnt; // buffer offset holds the new size
-
-    if (radio->buffer_offset >= resp_len)
+    // Each prompt ends the response to the oldest pending command - with more than one command in flight several
+    // responses can arrive in one read, and a prompt can be split across reads
+    uint32_t cnt = 0;
+    while ((cnt = radio->sk->read(radio->response_buffer, BUFFER_SIZE)) > 0)
     {
-        if (strncmp((char *)radio->response_buffer + (radio->buffer_offset - resp_len), RESPONSE_COMPLETE_STR, resp_len) == 0)
+        uint32_t offset = 0;
+        while (offset < cnt)
         {
-            _parse_response_to_radio_data(radio);
-            radio->buffer_offset = 0;
-            radio->prev_cmd = radio->cur_cmd;
-            radio->cur_cmd = -1;
-            bzero(radio->response_buffer, resp_len);
+            bool found = false;
+            uint32_t used = radio->prompt_matcher.scan(radio->response_buffer + offset, cnt - offset, &found);
+            radio->parser.parse(radio->response_buffer + offset, used, radio);
+            offset += used;
+            if (!found)
+                break;
+
+            radio->parser.reset();
+            if (radio->pending_count == 0)
+                continue;
+
+            radio->prev_cmd = radio->pending_cmds[0];
+            --radio->pending_count;
+            memmove(radio->pending_cmds, radio->pending_cmds + 1, radio->pending_count);
+
+            if (radio->prev_cmd == cmd::ind::RSTAT)
+                ++radio->complete_scan_count;
         }
     }
 
-    if (radio->cur_cmd == INVALID_VALUE)
+    // Keep the pipeline full - commands are always sent in the same ID, FREQ, MEAS, RSTAT order
+    while (radio->pending_count < _pipeline_depth)
     {
-        radio->cur_cmd = radio->prev_cmd + 1;
-        if (radio->cur_cmd > cmd::ind::RSTAT)
-            radio->cur_cmd = cmd::ind::ID;
+        uint8_t next_cmd = radio->last_sent_cmd + 1;
+        if (next_cmd > cmd::ind::RSTAT)
+            next_cmd = cmd::ind::ID;
 
-        radio->sk->write(commands[radio->cur_cmd].c_str());
-    }
+        if (radio->sk->write(commands[next_cmd].c_str()) == 0)
+            break;
 
-    if (radio->cur_cmd == cmd::ind::ID && radio->prev_cmd == cmd::ind::RSTAT)
-        ++radio->complete_scan_count;
+        radio->pending_cmds[radio->pending_count] = next_cmd;
+        ++radio->pending_count;
+        radio->last_sent_cmd = next_cmd;
+    }
 }
 
 void Radio_Telnet::_update_closed(CM300_Radio * radio)
@@ -1168,121 +2009,64 @@ void Radio_Telnet::_update_closed(CM300_Radio * radio)
              radio->sk->get_port(),
              radio->sk->fd(),
              Threaded_Fd::error_string(radio->sk->error()));
+        ilog("Socket buffers for {} - {}", radio->sk->get_ip(), Threaded_Fd::buffer_stats_string(radio->sk->buffer_stats()));
         radio->sk->stop();
-        if (radio->retry_count < _max_retry_count)
-        {
-            ++radio->retry_count;
-            ilog("Attempting to reconnect to radio at {} on socket fd {}", radio->sk->get_ip(), radio->sk->fd());
 
-            if (radio->sk->connect(radio->sk->get_ip(), radio->sk->get_port(), _conn_timeout) == 0)
-            {
-                if (radio->sk->start())
-                {
-                    ilog("Opened connection to radio at {} on socket fd {}", radio->sk->get_ip(), radio->sk->fd());
-                }
-                else
-                {
-                    ilog("Could not start socket for {} on threaded fd: {}", radio->sk->get_ip(), Threaded_Fd::error_string(radio->sk->error()));
-                }
-            }
-            else
-            {
-                ilog("Connection timeout to {}", radio->sk->get_ip(), strerror(errno));
-            }
+        // Reconnecting is done in the background so the other radios keep getting polled in the mean time - until
+        // it's handed back this radio has no socket
+        if (_reconnect->running())
+        {
+            ilog("Handing radio at {} to the reconnect service", radio->sk->get_ip());
+            _reconnect->submit(radio, radio->sk);
         }
         else
         {
-            ilog("Reached max retry count for {} - giving up. Bye bye to socket on fd {}.", radio->sk->get_ip(), radio->sk->fd());
+            ilog("Reconnect service not running - giving up on radio at {}", radio->sk->get_ip());
             delete radio->sk;
-            radio->sk = nullptr;
         }
+        radio->sk = nullptr;
     }
 }
 
-void Radio_Telnet::_extract_string_to_radio(CM300_Radio * radio, const std::string & str)
+void Radio_Telnet::_update_reconnected()
 {
-    size_t pos = str.find(':');
-    if (pos == std::string::npos)
-        return;
-    std::string param_name = str.substr(0, pos);
-    std::string param_value = str.substr(pos + 1, str.size() - pos + 1);
-    if (param_name == "RADIOID")
-    {
-        radio->serial = param_value;
-    }
-    else if (param_name == "OPERATINGFREQUENCY")
-    {
-        radio->freq_mhz = std::stof(param_value);
-    }
-    else if (param_name == "FORWARDPOWER")
-    {
-        radio->tx.forward_power = std::stof(param_value.substr(0, param_value.size() - 1));
-    }
-    else if (param_name == "REFLECTEDPOWER")
-    {
-        radio->tx.reverse_power = std::stof(param_value.substr(0, param_value.size() - 1));
-    }
-    else if (param_name == "SWR")
-    {
-        radio->tx.vswr = std::stof(param_value);
-    }
-    else if (param_name == "AGC")
-    {
-        radio->rx.agc = std::stof(param_value.substr(0, param_value.size() - 1));
-    }
-    else if (param_name == "LINELEVEL")
-    {
-        radio->rx.line_level = std::stof(param_value.substr(0, param_value.size() - 3));
-    }
-    else if (param_name == "PTTSTATUS")
-    {
-        if (param_value == "OFF")
-            radio->tx.ptt_status = PTT_OFF;
-        else if (param_value == "LOCAL")
-            radio->tx.ptt_status = PTT_LOCAL;
-        else if (param_value == "REMOTE")
-            radio->tx.ptt_status = PTT_REMOTE;
-        else if (param_value == "TESTRF")
-            radio->tx.ptt_status = PTT_TEST_RF;
-        else
-            radio->tx.ptt_status = INVALID_VALUE;
-    }
-    else if (param_name == "SQUELCHBREAKSTATUS")
-    {
-        if (param_value == "CLOSED")
-            radio->rx.squelch_status = SQUELCH_CLOSED;
-        else if (param_value == "OPEN")
-            radio->rx.squelch_status = SQUELCH_OPEN;
-        else
-            radio->rx.squelch_status = INVALID_VALUE;
-    }
-    else
+    _reconnect->collect(_reconnect_results);
+    for (size_t i = 0; i < _reconnect_results.size(); ++i)
     {
-        // Skip - no need to update anything
-    }
-}
+        const Reconnect_Result & res = _reconnect_results[i];
 
-void Radio_Telnet::_parse_response_to_radio_data(CM300_Radio * radio)
-{
-    std::string curline;
+        // Look the radio up by address - a config reload could have moved it or dropped it from the range
+        CM300_Radio * radio = _find_radio(res.ip);
+        if (!radio || radio->sk)
+        {
+            ilog("No radio at {} is waiting on a reconnect any more (the config was reloaded) - dropping it", res.ip);
+            delete res.sk;
+            continue;
+        }
+        radio->retry_count = res.attempts;
+        if (!res.sk)
+        {
+            ilog("Reached max retry count of {} for radio at {} - giving up", res.attempts, res.ip);
+            continue;
+        }
 
-    for (int i = 0; i < radio->buffer_offset; ++i)
-    {
-        char c = radio->response_buffer[i];
-        radio->response_buffer[i] = 0;
-        if (c == '\n')
+        // Start the conversation over just like at startup
+        radio->sk = res.sk;
+        radio->reset_commands();
+        radio->sk->set_reactor(_reactor);
+        radio->sk->set_notify_fd(edm.wake_fd());
+        if (radio->sk->start())
         {
-            if (curline.find(':') != std::string::npos)
-            {
-                _extract_string_to_radio(radio, curline);
-            }
-            curline.clear();
+            ilog("Opened connection to radio at {} on socket fd {}", radio->sk->get_ip(), radio->sk->fd());
         }
-        else if (c > ' ')
+        else
         {
-            curline.push_back(c);
+            ilog("Could not start socket for {} on threaded fd: {}", radio->sk->get_ip(), Threaded_Fd::error_string(radio->sk->error()));
+            _reconnect->submit(radio, radio->sk);
+            radio->sk = nullptr;
         }
     }
+    _reconnect_results.clear();
 }
 
 void Radio_Telnet::enable_logging(bool enable)
@@ -3,22 +3,38 @@
 #include <vector>
 #include <set>
 #include <unordered_map>
+#include <memory>
 
 #include "subsystem.h"
 #include "socket.h"
+#include "reconnect_service.h"
+#include "cm300_parser.h"
+#include "utility.h"
+#include "log_file.h"
+#include "log_format.h"
+#include "binary_log.h"
+#include "series_store.h"
+#include "log_archiver.h"
+#include "radio_telemetry.h"
+#include "radio_history.h"
+#include "trigger_eval.h"
 
 #define MAP_CONTAINS(map,param) map.find(param) != map.end()
 
 class Socket;
+class Fd_Reactor;
+class Log_Writer;
+struct Drive_Job;
 
 const int8_t COMMAND_COUNT = 4;
+const uint16_t RADIO_PORT = 8081;
+const std::string RADIO_IP_PREFIX = "192.168.102.";
+const uint32_t DEFAULT_DISCOVERY_WINDOW = 64;
+const uint8_t MAX_COMMAND_PIPELINE_DEPTH = 8;
 const int16_t BUFFER_SIZE = 512;
+const uint8_t RADIO_SERIAL_SIZE = 16;
 const char RESPONSE_COMPLETE_STR[] = "CM300V2> ";
 
-const std::string RX_STR = "RX";
-const std::string TX_STR = "TX";
-const std::string NOT_READY_STR = "Not Initialized";
-
 namespace cmd
 {
 namespace str
@@ -37,33 +53,20 @@ extern const uint8_t RSTAT;
 } // namespace ind
 } // namespace cmd
 
-const uint8_t INVALID_VALUE = -1;
-const float INVALID_FLOAT = -100.0f;
 const float EPS = 0.001f;
 
-const uint8_t PTT_OFF = 1;
-const uint8_t PTT_LOCAL = 2;
-const uint8_t PTT_REMOTE = 4;
-const uint8_t PTT_TEST_RF = 8;
-
 const uint8_t LOPTIONA_DELTA = 1;
 const uint8_t LOPTIONA_NEQUAL = 2;
 const uint8_t LOPTIONA_EQUAL = 4;
 const uint8_t LOPTIONA_GTHANEQUAL = 2;
 const uint8_t LOPTIONA_LTHAN = 4;
 
-const uint8_t SQUELCH_CLOSED = 1;
-const uint8_t SQUELCH_OPEN = 2;
-
 struct Command_Info
 {
     std::string name;
     std::string resp_key;
 };
 
-std::string ptt_string(uint8_t status);
-std::string squelch_string(uint8_t status);
-
 struct TX_Params
 {
     TX_Params();
@@ -98,21 +101,57 @@ struct CM300_Radio
     std::string radio_range() const;
     std::string to_string() const;
     bool initialized() const;
+    bool is_tx() const;
+
+    /// Start the command sequence over for a new connection - the radio's greeting is taken as the first response
+    void reset_commands();
+
+    // The radio's values live in its telemetry row
+    float freq_mhz() const;
+    TX_Params tx() const;
+    RX_Params rx() const;
+    void set_tx(const TX_Params & params);
+    void set_rx(const RX_Params & params);
 
     Socket * sk;
-    float freq_mhz;
+
+    // Address the radio was discovered at - kept while sk is with the reconnect service (empty for simulated radios)
+    std::string ip;
     std::string serial;
-    TX_Params tx;
-    RX_Params rx;
+    Radio_Telemetry * telemetry;
+    uint32_t row;
 
-    uint8_t cur_cmd;
+    // Commands sent and not yet answered, oldest first - responses come back in the order the commands were sent
+    uint8_t pending_cmds[MAX_COMMAND_PIPELINE_DEPTH];
+    uint8_t pending_count;
+    uint8_t last_sent_cmd;
     uint8_t prev_cmd;
-    uint16_t buffer_offset;
+    // Responses are parsed as they are read, so the buffer only ever holds the latest read and a response of any
+    // size is fine
     uint8_t response_buffer[BUFFER_SIZE];
+    util::Delimiter_Matcher prompt_matcher;
+    CM300_Parser parser;
     uint8_t retry_count;
     size_t complete_scan_count;
 };
 
+/// Just the parts of a radio that get logged - plain data so it can be queued for the csv writer thread
+struct Radio_Sample
+{
+    Radio_Sample();
+    Radio_Sample(const CM300_Radio & radio);
+
+    std::string radio_type() const;
+    std::string radio_range() const;
+    bool is_tx() const;
+    bool is_rx() const;
+
+    char serial[RADIO_SERIAL_SIZE];
+    float freq_mhz;
+    TX_Params tx;
+    RX_Params rx;
+};
+
 template<class T>
 struct Log_Item_Option
 {
@@ -131,47 +170,167 @@ struct Log_Option_Group
     Log_Item_Option<float> change;
     Log_Item_Option<float> percent_change;
     Log_Item_Option<int32_t> equal;
+
+    // The less_than/greater_than/equal condition only counts once it has held this long
+    Log_Item_Option<uint32_t> hold_ms;
+};
+
+/// What a logger writes its rows as
+enum Log_Format
+{
+    LOG_FORMAT_CSV,
+    LOG_FORMAT_BINARY,
+    LOG_FORMAT_SERIES
 };
 
 struct Logger_Options
 {
-    Logger_Options(): dir_path(), period(0), log_changes_to_status(false) {}
+    Logger_Options();
+
+    /// Build the column lists and titles from items/enabled_mask - call once the items are filled in
+    void compile();
+
+    bool enabled(uint8_t param) const;
+
     std::string dir_path;
     uint32_t period;
     bool log_changes_to_status;
+    Log_Format format;
+
+    // Options for each Log_Param (indexed by it) - a param gets a column if its bit is set in enabled_mask
+    Log_Option_Group items[LP_COUNT];
+    uint32_t enabled_mask;
+
+    // Filled in by compile() - the enabled params in column order for each radio type, and each column's header
+    Log_Columns columns;
+
+    // The item conditions as thresholds for the trigger kernels - float or status depending on the param
+    Float_Trigger float_triggers[LP_COUNT];
+    Status_Trigger status_triggers[LP_COUNT];
 
-    /* 
-    The option keys for log item options so far are listed below:
-        ptt_status
-        squelch_status
-        forward_power
-        reverse_power
-        vswr
-        agc
-        line_level
-     */
-    std::unordered_map<std::string, Log_Option_Group> item_options;
+    // Params (bit per Log_Param) with a hold_ms - their level conditions are checked against the radio history
+    // rather than by the kernels
+    uint32_t hold_mask;
+    History_Condition held[LP_COUNT];
 };
 
 struct Logger_Entry
 {
-    Logger_Entry() : ms_counter(0)
+    Logger_Entry()
+        : ms_counter(0),
+          triggers_stale(true),
+          writer(nullptr),
+          archiver(nullptr),
+          max_file_size(0),
+          file(std::make_shared<Log_File>()),
+          file_day_end(0),
+          file_part(1),
+          last_stale_check_ms(0),
+          bin_schema_valid(false)
     {}
-    void update_and_log_if_needed(const std::vector<CM300_Radio> & radios);
+    void update_and_log_if_needed(const std::vector<CM300_Radio> & radios, const Radio_Telemetry & tel, const Radio_History & history);
+
+    /// Take radios as the logged state and forget anything cached about them
+    void reset_state(const std::vector<CM300_Radio> & radios, const Radio_Telemetry & tel);
+
+    /// Copy the logged values of radios in to prev_state/logged
+    void snapshot_state(const std::vector<CM300_Radio> & radios, const Radio_Telemetry & tel);
+
+    /// Run the trigger kernels for every column over every radio in to cached_triggers, and check the held conditions
+    /// against history
+    void evaluate_all(const Radio_Telemetry & tel, const Radio_History & history);
+
+    /// Check one radio against its logged state, printing status messages for changes if enabled - returns
+    /// TRIGGER_* bits
+    uint8_t evaluate_radio(size_t rind, const CM300_Radio & radio, const Radio_Telemetry & tel);
+
+    /// Queue the header/a row for prev_state with the writer
     bool write_headers_to_file();
     bool write_radio_data_to_file();
-    std::string get_header();
-    std::string get_row();
-    std::string get_fname();
+
+    /// Writer thread side of the above - samples is the snapshot of prev_state queued with it
+    bool write_header_now(const Radio_Sample * samples, uint32_t count, int64_t wall_ms, double elapsed_s);
+    bool write_row_now(const Radio_Sample * samples, uint32_t count, int64_t wall_ms, double elapsed_s);
+
+    /// Binary format versions of the above - the header is a schema block
+    bool write_binary_header_now(const Radio_Sample * samples, uint32_t count, time_t wall_time, double elapsed_s);
+    bool write_binary_row_now(const Radio_Sample * samples, uint32_t count, time_t wall_time, double elapsed_s);
+
+    /// Append a schema for samples to row_buffer
+    void append_binary_schema(const Radio_Sample * samples, uint32_t count, uint8_t flags, time_t wall_time, double elapsed_s);
+
+    /// Series format version of write_row_now - there is no header
+    bool write_series_row_now(const Radio_Sample * samples, uint32_t count, int64_t wall_ms);
+
+    /// Write out the series chunks in row_buffer (if any)
+    bool write_series_chunks();
+
+    std::string get_header(const Radio_Sample * samples, uint32_t count);
+
+    /// Format a row in to row (cleared first) - reusing the same string means no allocating once it is big enough
+    void get_row(const Radio_Sample * samples, uint32_t count, time_t wall_time, double elapsed_s, std::string * row);
+    /// Log file name for today without the part or extension
+    std::string get_fname_base();
+
+    const char * get_fname_extension() const;
+
+    /// True once the open file should be closed for the next one - the day rolled over or it reached max_file_size
+    bool file_expired(time_t now) const;
+
+    /// Make sure today's file (or part of it) is open, falling back to the backup dir - created is set if it is a new
+    /// file
+    bool open_file(bool * created = nullptr);
+
+    /// Flush/fsync on schedule and drop the file if it was deleted or its drive swapped out
+    void update_file();
+
+    /// Write out anything held back (ie partly filled series chunks) and close the file
+    void close_file();
+
+    /// True if the open file is in the backup dir because dir_path couldn't be opened
+    bool in_backup_dir() const;
 
     Logger_Options loptions;
+
+    // The logger's json object from the config along with the shared settings that affect it - a reload only replaces
+    // loggers whose signature changed
+    std::string cfg_signature;
+
     double ms_counter;
     std::string _backup_log_dir;
     std::string name;
-    std::vector<CM300_Radio> prev_state;
+    // Radios as of the last logged row (as samples for the writer and column wise for the kernels), and for each radio
+    // the generation it was last checked at and what was found
+    std::vector<Radio_Sample> prev_state;
+    Radio_Telemetry logged;
+    std::vector<uint32_t> checked_generation;
+    std::vector<uint8_t> cached_triggers;
+    bool triggers_stale;
+    Log_Writer * writer;
+
+    // Told which file we are writing so it leaves it alone - can be null
+    Log_Archiver * archiver;
+
+    // Files past this many bytes are closed and the next part started - 0 for no limit
+    uint64_t max_file_size;
+
+    // Everything below belongs to the writer thread once the entry is in _loggers
+    // Shared so entries can still be copied around while being set up - only ever opened once it is in _loggers
+    std::shared_ptr<Log_File> file;
+    time_t file_day_end;
+    uint32_t file_part;
+    double last_stale_check_ms;
+    std::string row_buffer;
+
+    // The schema the binary records in the open file are written against - invalid until one is written to it
+    Binary_Log_Schema bin_schema;
+    bool bin_schema_valid;
+
+    // Open chunks for the series format - null for the others
+    std::shared_ptr<Series_Writer> series;
 };
 
-void create_simulated_radio_set(std::vector<CM300_Radio> & radios, int vcount, int ucount);
+void create_simulated_radio_set(std::vector<CM300_Radio> & radios, Radio_Telemetry & tel, int vcount, int ucount);
 
 class Radio_Telnet : public Subsystem
 {
@@ -212,13 +371,24 @@ class Radio_Telnet : public Subsystem
 
   private:
     void _update_closed(CM300_Radio * radio);
+    void _update_reconnected();
     void _update(CM300_Radio * radio);
-    void _parse_response_to_radio_data(CM300_Radio * radio);
-    void _extract_string_to_radio(CM300_Radio * radio, const std::string & str);
-    void _set_options_from_config_file(Config_File * cfg);
+    void _set_options_from_config_file(Config_File * cfg, std::unordered_map<std::string, Logger_Entry> * loggers);
+    void _reload_config(Config_File * cfg);
+    Reconnect_Config _reconnect_config();
+    void _update_loggers(std::unordered_map<std::string, Logger_Entry> & loggers);
+    void _update_radio_range(int32_t prev_lb, int32_t prev_ub);
+    void _remove_radio(CM300_Radio * radio);
+    bool _start_radio(Socket * sk, CM300_Radio * radio);
+    CM300_Radio * _find_radio(const std::string & ip);
     void _simulated_radios_update();
     void _update_usb_drive_status();
+    void _drive_mounted(Drive_Job * job);
+    void _drive_unmounted(Drive_Job * job);
+    void _reset_loggers();
+    void _close_log_files();
     void _init_radios();
+    void _discover_radios(const std::vector<int32_t> & hosts, std::vector<Socket *> & found);
 
     bool _logging;
     bool _reset_sim;
@@ -232,6 +402,23 @@ class Radio_Telnet : public Subsystem
     int8_t _ip_ub;
     uint8_t _max_retry_count;
     Timeout_Interval _conn_timeout;
+    uint32_t _discovery_window;
+    uint8_t _pipeline_depth;
+
+    uint32_t _io_worker_count;
+    Fd_Reactor * _reactor;
+    Fd_Buffer_Config _socket_buffers;
+    Log_File_Config _csv_file_cfg;
+    uint32_t _csv_queue_size;
+    Log_Writer * _log_writer;
+    uint32_t _series_chunk_points;
+    uint32_t _series_chunk_span_ms;
+    History_Config _history_cfg;
+
+    uint32_t _reconnect_min_delay_ms;
+    uint32_t _reconnect_max_delay_ms;
+    Reconnect_Service * _reconnect;
+    std::vector<Reconnect_Result> _reconnect_results;
 
     std::set<CM300_Radio *> initialized_radios;
     bool all_radios_init;
@@ -240,6 +427,11 @@ class Radio_Telnet : public Subsystem
     std::string commands[COMMAND_COUNT];
     std::unordered_map<std::string, Logger_Entry> _loggers;
 
+    // _radios[i] owns row i of _telemetry
     std::vector<CM300_Radio> _radios;
+    Radio_Telemetry _telemetry;
+
+    // Fed from _telemetry every update - rows match _telemetry's
+    Radio_History _history;
     size_t complete_scans;
 };
\ No newline at end of file
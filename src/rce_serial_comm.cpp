@@ -136,6 +136,11 @@ void RCE_Serial_Comm::init(Config_File * config)
     df.sb = Uart::One;
     rce_uart_->set_format(df);
 
+    Fd_Buffer_Config buf_cfg = rce_uart_->buffer_config();
+    if (fill_buffer_config_if_found(config, "uart_buffers", &buf_cfg))
+        rce_uart_->set_buffer_config(buf_cfg);
+
+    rce_uart_->set_notify_fd(edm.wake_fd());
     rce_uart_->start();
     rce_uart_->write("Starting Radio Monitor\r");
 }
@@ -143,6 +148,7 @@ void RCE_Serial_Comm::init(Config_File * config)
 void RCE_Serial_Comm::release()
 {
     Subsystem::release();
+    ilog("Uart {} buffers - {}", rce_uart_->device_path(), Threaded_Fd::buffer_stats_string(rce_uart_->buffer_stats()));
     rce_uart_->stop();
 }
 
@@ -196,6 +202,11 @@ void RCE_Serial_Comm::update()
                 reset_timer_->stop();
                 memset(current_command, 0, COMMAND_BUFFER_MAX_SIZE);
             }
+            else
+            {
+                // Come back when the command would time out if nothing else wakes us first
+                edm.schedule_update(MAX_TIMEOUT_MS - reset_timer_->elapsed() + 1);
+            }
         }
         else
         {
@@ -0,0 +1,341 @@
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <algorithm>
+
+#include "reconnect_service.h"
+#include "logger.h"
+#include "utility.h"
+
+Reconnect_Service::Reconnect_Service()
+    : m_cfg(), m_socket_buffers(), m_entries(), m_done(), m_cancelled(), m_done_count(0), m_running(false), m_notify_fd(-1), m_thread(0), m_rng(std::random_device()())
+{
+    pthread_mutex_init(&m_lock, nullptr);
+
+    // Wait on the monotonic clock so wall clock changes don't stall or rush the schedule
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&m_cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+Reconnect_Service::~Reconnect_Service()
+{
+    stop();
+    pthread_cond_destroy(&m_cond);
+    pthread_mutex_destroy(&m_lock);
+}
+
+bool Reconnect_Service::start(const Reconnect_Config & cfg, const Fd_Buffer_Config & socket_buffers)
+{
+    if (m_running)
+        return false;
+
+    set_config(cfg, socket_buffers);
+
+    m_running = true;
+    if (pthread_create(&m_thread, nullptr, Reconnect_Service::thread_exec, (void *)this) != 0)
+    {
+        elog("Could not create reconnect service thread: {}", strerror(errno));
+        m_running = false;
+        m_thread = 0;
+        return false;
+    }
+    return true;
+}
+
+void Reconnect_Service::set_config(const Reconnect_Config & cfg, const Fd_Buffer_Config & socket_buffers)
+{
+    pthread_mutex_lock(&m_lock);
+    m_cfg = cfg;
+    if (m_cfg.max_delay_ms < m_cfg.min_delay_ms)
+        m_cfg.max_delay_ms = m_cfg.min_delay_ms;
+    m_socket_buffers = socket_buffers;
+    pthread_mutex_unlock(&m_lock);
+}
+
+void Reconnect_Service::stop()
+{
+    if (m_running)
+    {
+        pthread_mutex_lock(&m_lock);
+        m_running = false;
+        pthread_cond_signal(&m_cond);
+        pthread_mutex_unlock(&m_lock);
+    }
+
+    if (m_thread)
+    {
+        pthread_join(m_thread, nullptr);
+        m_thread = 0;
+    }
+
+    // Nobody is coming for these anymore
+    for (size_t i = 0; i < m_entries.size(); ++i)
+        delete m_entries[i].sk;
+    for (size_t i = 0; i < m_done.size(); ++i)
+        delete m_done[i].sk;
+    m_entries.clear();
+    m_done.clear();
+    m_done_count = 0;
+}
+
+bool Reconnect_Service::running()
+{
+    return m_running;
+}
+
+void Reconnect_Service::set_notify_fd(int32_t efd)
+{
+    m_notify_fd = efd;
+}
+
+void Reconnect_Service::submit(CM300_Radio * radio, Socket * failed_sk)
+{
+    Entry ent;
+    ent.radio = radio;
+    ent.ip = failed_sk->get_ip();
+    ent.port = failed_sk->get_port();
+    ent.attempts = 0;
+    ent.sk = nullptr;
+
+    // The failed socket is stopped already, so this is just closing the fd
+    delete failed_sk;
+
+    pthread_mutex_lock(&m_lock);
+    m_cancelled.erase(ent.ip);
+    ent.next_attempt_ms = util::monotonic_ms() + _backoff_delay(0);
+    ilog("Scheduling reconnect to {} in {:.0f} ms", ent.ip, ent.next_attempt_ms - util::monotonic_ms());
+    m_entries.push_back(ent);
+    pthread_cond_signal(&m_cond);
+    pthread_mutex_unlock(&m_lock);
+}
+
+void Reconnect_Service::collect(std::vector<Reconnect_Result> & results)
+{
+    if (m_done_count.load(std::memory_order_acquire) == 0)
+        return;
+
+    pthread_mutex_lock(&m_lock);
+    results.insert(results.end(), m_done.begin(), m_done.end());
+    m_done.clear();
+    m_done_count = 0;
+    pthread_mutex_unlock(&m_lock);
+}
+
+void Reconnect_Service::cancel(const std::string & ip)
+{
+    pthread_mutex_lock(&m_lock);
+    auto iter = m_entries.begin();
+    while (iter != m_entries.end())
+    {
+        if (iter->ip == ip)
+        {
+            ilog("Cancelled reconnecting to {}", ip);
+            iter = m_entries.erase(iter);
+            continue;
+        }
+        ++iter;
+    }
+
+    // Not waiting doesn't mean it's done - it could be out being attempted right now
+    m_cancelled.insert(ip);
+    pthread_mutex_unlock(&m_lock);
+}
+
+uint32_t Reconnect_Service::pending_count()
+{
+    pthread_mutex_lock(&m_lock);
+    uint32_t cnt = m_entries.size();
+    pthread_mutex_unlock(&m_lock);
+    return cnt;
+}
+
+double Reconnect_Service::_backoff_delay(uint32_t attempt)
+{
+    double delay = m_cfg.min_delay_ms;
+    for (uint32_t i = 0; i < attempt && delay < m_cfg.max_delay_ms; ++i)
+        delay *= 2.0;
+    delay = std::min(delay, double(m_cfg.max_delay_ms));
+    std::uniform_real_distribution<double> jitter(0.5, 1.0);
+    return delay * jitter(m_rng);
+}
+
+void Reconnect_Service::_attempt(std::vector<Entry> & due, double timeout_ms, const Fd_Buffer_Config & socket_buffers)
+{
+    // Kick off all the connects, then wait on them together
+    std::vector<pollfd> pfds(due.size());
+    for (size_t i = 0; i < due.size(); ++i)
+    {
+        Entry & ent = due[i];
+        ++ent.attempts;
+        ent.sk = new Socket(socket_buffers);
+        pfds[i].fd = -1;
+        pfds[i].events = POLLOUT;
+        if (ent.sk->fd() == -1)
+        {
+            ilog("Failed to create socket to reconnect to {} - error: {}", ent.ip, strerror(errno));
+            delete ent.sk;
+            ent.sk = nullptr;
+        }
+        else if (ent.sk->begin_connect(ent.ip, ent.port) == 0)
+        {
+            // Connected right away - nothing to wait for
+        }
+        else if (errno == EINPROGRESS)
+        {
+            pfds[i].fd = ent.sk->fd();
+        }
+        else
+        {
+            ilog("Reconnect attempt {} to {} failed - {}", ent.attempts, ent.ip, strerror(errno));
+            delete ent.sk;
+            ent.sk = nullptr;
+        }
+    }
+
+    // Poll in slices so stop() isn't held up by a long connection timeout
+    double deadline = util::monotonic_ms() + timeout_ms;
+    while (m_running)
+    {
+        size_t waiting = 0;
+        for (size_t i = 0; i < pfds.size(); ++i)
+        {
+            if (pfds[i].fd != -1)
+                ++waiting;
+        }
+        double remaining = deadline - util::monotonic_ms();
+        if (waiting == 0 || remaining <= 0)
+            break;
+
+        int32_t wait_ms = std::min(int32_t(remaining), int32_t(RECONNECT_POLL_SLICE_MS));
+        int32_t cnt = poll(pfds.data(), pfds.size(), std::max(wait_ms, 1));
+        if (cnt < 0 && errno != EINTR)
+        {
+            elog("Poll failed in reconnect service: {}", strerror(errno));
+            break;
+        }
+
+        for (size_t i = 0; i < pfds.size(); ++i)
+        {
+            if (pfds[i].fd != -1 && pfds[i].revents != 0)
+                pfds[i].fd = -1;
+        }
+    }
+
+    for (size_t i = 0; i < due.size(); ++i)
+    {
+        Entry & ent = due[i];
+        if (!ent.sk)
+            continue;
+
+        // fd still set means the connect never finished
+        if (pfds[i].fd != -1)
+        {
+            ilog("Reconnect attempt {} to {} timed out", ent.attempts, ent.ip);
+            delete ent.sk;
+            ent.sk = nullptr;
+        }
+        else if (ent.sk->finish_connect() != 0)
+        {
+            ilog("Reconnect attempt {} to {} failed - {}", ent.attempts, ent.ip, strerror(errno));
+            delete ent.sk;
+            ent.sk = nullptr;
+        }
+    }
+}
+
+void Reconnect_Service::_exec()
+{
+    std::vector<Entry> due;
+    pthread_mutex_lock(&m_lock);
+    while (m_running)
+    {
+        // Pull out everything that is due and find when the next one will be
+        double now = util::monotonic_ms();
+        double next = -1;
+        auto iter = m_entries.begin();
+        while (iter != m_entries.end())
+        {
+            if (iter->next_attempt_ms <= now)
+            {
+                due.push_back(*iter);
+                iter = m_entries.erase(iter);
+                continue;
+            }
+            if (next < 0 || iter->next_attempt_ms < next)
+                next = iter->next_attempt_ms;
+            ++iter;
+        }
+
+        if (due.empty())
+        {
+            if (next < 0)
+            {
+                pthread_cond_wait(&m_cond, &m_lock);
+            }
+            else
+            {
+                timespec ts;
+                clock_gettime(CLOCK_MONOTONIC, &ts);
+                int64_t wait_ms = int64_t(next - now) + 1;
+                ts.tv_sec += wait_ms / 1000;
+                ts.tv_nsec += (wait_ms % 1000) * 1000000;
+                if (ts.tv_nsec >= 1000000000)
+                {
+                    ts.tv_nsec -= 1000000000;
+                    ++ts.tv_sec;
+                }
+                pthread_cond_timedwait(&m_cond, &m_lock, &ts);
+            }
+            continue;
+        }
+
+        // Don't hold the lock while connecting - submit() and collect() are called from the main loop, and
+        // set_config() on a config reload
+        double timeout_ms = m_cfg.timeout.to_ms();
+        Fd_Buffer_Config socket_buffers = m_socket_buffers;
+        pthread_mutex_unlock(&m_lock);
+        _attempt(due, timeout_ms, socket_buffers);
+        pthread_mutex_lock(&m_lock);
+
+        for (size_t i = 0; i < due.size(); ++i)
+        {
+            Entry & ent = due[i];
+            if (m_cancelled.count(ent.ip) != 0)
+            {
+                ilog("Dropping reconnect attempt {} to {} - it was cancelled", ent.attempts, ent.ip);
+                delete ent.sk;
+            }
+            else if (ent.sk)
+            {
+                ilog("Reconnected to {} after {} attempt(s)", ent.ip, ent.attempts);
+                m_done.push_back(Reconnect_Result(ent.radio, ent.ip, ent.sk, ent.attempts));
+            }
+            else if (m_cfg.max_attempts != RECONNECT_UNLIMITED_RETRIES && ent.attempts >= m_cfg.max_attempts)
+            {
+                m_done.push_back(Reconnect_Result(ent.radio, ent.ip, nullptr, ent.attempts));
+            }
+            else
+            {
+                ent.next_attempt_ms = util::monotonic_ms() + _backoff_delay(ent.attempts);
+                m_entries.push_back(ent);
+            }
+        }
+        due.clear();
+        m_cancelled.clear();
+        m_done_count.store(m_done.size(), std::memory_order_release);
+        if (!m_done.empty())
+            util::signal_event_fd(m_notify_fd);
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+void * Reconnect_Service::thread_exec(void * _this)
+{
+    Reconnect_Service * svc = static_cast<Reconnect_Service *>(_this);
+    svc->_exec();
+    return nullptr;
+}
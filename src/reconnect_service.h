@@ -0,0 +1,119 @@
+#pragma once
+
+#include <pthread.h>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <atomic>
+#include <random>
+
+#include "socket.h"
+
+#define DEFAULT_RECONNECT_MIN_DELAY_MS 500
+#define DEFAULT_RECONNECT_MAX_DELAY_MS 30000
+#define RECONNECT_POLL_SLICE_MS 100
+#define RECONNECT_UNLIMITED_RETRIES 255
+
+struct CM300_Radio;
+
+/// Reconnect schedule - the delay before attempt n is min_delay_ms * 2^n capped at max_delay_ms, with a random
+/// jitter taking off up to half so radios that dropped together don't all retry together
+struct Reconnect_Config
+{
+    Reconnect_Config()
+        : min_delay_ms(DEFAULT_RECONNECT_MIN_DELAY_MS), max_delay_ms(DEFAULT_RECONNECT_MAX_DELAY_MS), max_attempts(10), timeout(0, 500000)
+    {}
+
+    uint32_t min_delay_ms;
+    uint32_t max_delay_ms;
+
+    // RECONNECT_UNLIMITED_RETRIES (or -1 in the config file) means keep trying forever
+    uint8_t max_attempts;
+    Timeout_Interval timeout;
+};
+
+/// Result of reconnecting a dropped radio - sk is the newly connected (but not started) socket, or null if the
+/// service gave up after max_attempts
+struct Reconnect_Result
+{
+    Reconnect_Result(CM300_Radio * radio_ = nullptr, const std::string & ip_ = std::string(), Socket * sk_ = nullptr, uint32_t attempts_ = 0)
+        : radio(radio_), ip(ip_), sk(sk_), attempts(attempts_)
+    {}
+
+    CM300_Radio * radio;
+    std::string ip;
+    Socket * sk;
+    uint32_t attempts;
+};
+
+/// Reconnects dropped radio sockets on its own thread so the main loop never blocks on a connect. The main loop
+/// hands over the failed socket with submit() and picks up results with collect() - every attempt uses a fresh
+/// socket, and attempts that are due at the same time are connected concurrently.
+class Reconnect_Service
+{
+  public:
+    Reconnect_Service();
+    ~Reconnect_Service();
+
+    bool start(const Reconnect_Config & cfg, const Fd_Buffer_Config & socket_buffers);
+
+    /// Replace the schedule and socket buffer sizes while running - the next attempt to each radio uses them
+    void set_config(const Reconnect_Config & cfg, const Fd_Buffer_Config & socket_buffers);
+
+    void stop();
+
+    bool running();
+
+    /// eventfd to signal whenever a reconnect finishes (ie Main_Control::wake_fd) - -1 for none
+    void set_notify_fd(int32_t efd);
+
+    /// Take ownership of radio's failed (stopped) socket and start reconnecting to its address
+    void submit(CM300_Radio * radio, Socket * failed_sk);
+
+    /// Move all finished reconnects in to results - cheap to call every update when there are none
+    void collect(std::vector<Reconnect_Result> & results);
+
+    /// Stop reconnecting to ip - an attempt already in progress is dropped (its socket closed) once it finishes rather
+    /// than showing up in collect() or being retried
+    void cancel(const std::string & ip);
+
+    /// Number of radios currently being reconnected
+    uint32_t pending_count();
+
+  private:
+    struct Entry
+    {
+        CM300_Radio * radio;
+        std::string ip;
+        int16_t port;
+        uint32_t attempts;
+        double next_attempt_ms;
+        Socket * sk;
+    };
+
+    double _backoff_delay(uint32_t attempt);
+    void _attempt(std::vector<Entry> & due, double timeout_ms, const Fd_Buffer_Config & socket_buffers);
+    void _exec();
+
+    static void * thread_exec(void *);
+
+    // All guarded by m_lock
+    Reconnect_Config m_cfg;
+    Fd_Buffer_Config m_socket_buffers;
+    std::vector<Entry> m_entries;
+    std::vector<Reconnect_Result> m_done;
+
+    // Addresses cancelled while an attempt to them might have been in progress - cleared after every attempt
+    std::set<std::string> m_cancelled;
+
+    std::atomic_uint_fast32_t m_done_count;
+    std::atomic_bool m_running;
+    int32_t m_notify_fd;
+
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_cond;
+    pthread_t m_thread;
+
+    std::mt19937 m_rng;
+};
@@ -0,0 +1,454 @@
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <limits>
+
+#include "series_store.h"
+
+template<class T>
+static void append_pod(const T & val, std::string * out)
+{
+    out->append(reinterpret_cast<const char *>(&val), sizeof(T));
+}
+
+template<class T>
+static const uint8_t * read_pod(const uint8_t * data, T * val)
+{
+    memcpy(val, data, sizeof(T));
+    return data + sizeof(T);
+}
+
+static uint32_t float_bits(float val)
+{
+    uint32_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    return bits;
+}
+
+static float bits_float(uint32_t bits)
+{
+    float val;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+Series_Chunk_Info::Series_Chunk_Info() : serial(), param(0), count(0), first_ms(0), last_ms(0), size(0), offset(0)
+{}
+
+Series_Encoder::Series_Encoder()
+    : m_bytes(), m_free_bits(0), m_count(0), m_first_ms(0), m_last_ms(0), m_last_delta(0), m_last_value(0), m_last_lead(32), m_last_trail(0)
+{}
+
+void Series_Encoder::reset()
+{
+    m_bytes.clear();
+    m_free_bits = 0;
+    m_count = 0;
+    m_first_ms = 0;
+    m_last_ms = 0;
+    m_last_delta = 0;
+    m_last_value = 0;
+    m_last_lead = 32;
+    m_last_trail = 0;
+}
+
+bool Series_Encoder::append(int64_t t_ms, float value)
+{
+    uint32_t bits = float_bits(value);
+    if (m_count == 0)
+    {
+        m_first_ms = t_ms;
+        _put_bits(bits, 32);
+    }
+    else
+    {
+        // Times only go forward within a chunk so its first/last times bound it
+        int64_t delta = t_ms - m_last_ms;
+        int64_t dod = delta - m_last_delta;
+        if (m_count >= SERIES_MAX_CHUNK_POINTS || delta < 0 || dod < std::numeric_limits<int32_t>::min() ||
+            dod > std::numeric_limits<int32_t>::max())
+            return false;
+
+        // Regular sampling makes most of these 0 - a single bit
+        if (dod == 0)
+        {
+            _put_bits(0, 1);
+        }
+        else if (dod >= -63 && dod <= 64)
+        {
+            _put_bits(2, 2);
+            _put_bits(dod + 63, 7);
+        }
+        else if (dod >= -255 && dod <= 256)
+        {
+            _put_bits(6, 3);
+            _put_bits(dod + 255, 9);
+        }
+        else if (dod >= -2047 && dod <= 2048)
+        {
+            _put_bits(14, 4);
+            _put_bits(dod + 2047, 12);
+        }
+        else
+        {
+            _put_bits(15, 4);
+            _put_bits(uint32_t(int32_t(dod)), 32);
+        }
+        m_last_delta = delta;
+
+        // Unchanged values are a single bit, and a change that fits in the previous change's bit window just needs
+        // its meaningful bits
+        uint32_t xor_val = bits ^ m_last_value;
+        if (xor_val == 0)
+        {
+            _put_bits(0, 1);
+        }
+        else
+        {
+            uint8_t lead = __builtin_clz(xor_val);
+            uint8_t trail = __builtin_ctz(xor_val);
+            if (lead >= m_last_lead && trail >= m_last_trail)
+            {
+                _put_bits(2, 2);
+                _put_bits(xor_val >> m_last_trail, 32 - m_last_lead - m_last_trail);
+            }
+            else
+            {
+                uint8_t meaningful = 32 - lead - trail;
+                _put_bits(3, 2);
+                _put_bits(lead, 5);
+                _put_bits(meaningful - 1, 5);
+                _put_bits(xor_val >> trail, meaningful);
+                m_last_lead = lead;
+                m_last_trail = trail;
+            }
+        }
+    }
+    m_last_ms = t_ms;
+    m_last_value = bits;
+    ++m_count;
+    return true;
+}
+
+uint32_t Series_Encoder::count() const
+{
+    return m_count;
+}
+
+int64_t Series_Encoder::first_ms() const
+{
+    return m_first_ms;
+}
+
+int64_t Series_Encoder::last_ms() const
+{
+    return m_last_ms;
+}
+
+void Series_Encoder::write_chunk(const char * serial, uint8_t param, std::string * out) const
+{
+    char padded[SERIES_SERIAL_SIZE] = {};
+    strncpy(padded, serial, SERIES_SERIAL_SIZE - 1);
+
+    out->append(SERIES_CHUNK_MAGIC, 4);
+    out->push_back(SERIES_VERSION);
+    out->append(padded, SERIES_SERIAL_SIZE);
+    out->push_back(param);
+    append_pod(uint16_t(m_count), out);
+    append_pod(m_first_ms, out);
+    append_pod(m_last_ms, out);
+    append_pod(uint32_t(m_bytes.size()), out);
+    out->append(reinterpret_cast<const char *>(m_bytes.data()), m_bytes.size());
+}
+
+void Series_Encoder::_put_bits(uint64_t bits, uint8_t nbits)
+{
+    // Most significant bit first, filling the last byte before starting another
+    while (nbits > 0)
+    {
+        if (m_free_bits == 0)
+        {
+            m_bytes.push_back(0);
+            m_free_bits = 8;
+        }
+        uint8_t n = std::min(nbits, m_free_bits);
+        uint8_t part = uint8_t((bits >> (nbits - n)) & ((1u << n) - 1));
+        m_bytes.back() |= uint8_t(part << (m_free_bits - n));
+        m_free_bits -= n;
+        nbits -= n;
+    }
+}
+
+Series_Decoder::Series_Decoder(const uint8_t * data, uint32_t size, uint32_t count, int64_t first_ms)
+    : m_data(data), m_size(size), m_bit(0), m_count(count), m_read(0), m_last_ms(first_ms), m_last_delta(0), m_last_value(0), m_last_lead(0), m_last_trail(0)
+{}
+
+bool Series_Decoder::next(Series_Point * pt)
+{
+    if (m_read == m_count)
+        return false;
+
+    uint64_t bits = 0;
+    if (m_read == 0)
+    {
+        if (!_get_bits(32, &bits))
+            return false;
+        m_last_value = uint32_t(bits);
+    }
+    else
+    {
+        // Count the leading ones of the time control bits - up to four
+        uint8_t ones = 0;
+        while (ones < 4)
+        {
+            if (!_get_bits(1, &bits))
+                return false;
+            if (bits == 0)
+                break;
+            ++ones;
+        }
+
+        int64_t dod = 0;
+        static const uint8_t DOD_BITS[] = {0, 7, 9, 12};
+        static const int32_t DOD_OFFSET[] = {0, 63, 255, 2047};
+        if (ones == 4)
+        {
+            if (!_get_bits(32, &bits))
+                return false;
+            dod = int32_t(uint32_t(bits));
+        }
+        else if (ones > 0)
+        {
+            if (!_get_bits(DOD_BITS[ones], &bits))
+                return false;
+            dod = int64_t(bits) - DOD_OFFSET[ones];
+        }
+        m_last_delta += dod;
+        m_last_ms += m_last_delta;
+
+        if (!_get_bits(1, &bits))
+            return false;
+        if (bits != 0)
+        {
+            if (!_get_bits(1, &bits))
+                return false;
+            if (bits != 0)
+            {
+                uint64_t lead = 0;
+                uint64_t meaningful = 0;
+                if (!_get_bits(5, &lead) || !_get_bits(5, &meaningful))
+                    return false;
+                m_last_lead = uint8_t(lead);
+                m_last_trail = uint8_t(32 - lead - (meaningful + 1));
+            }
+            if (!_get_bits(32 - m_last_lead - m_last_trail, &bits))
+                return false;
+            m_last_value ^= uint32_t(bits << m_last_trail);
+        }
+    }
+
+    pt->t_ms = m_last_ms;
+    pt->value = bits_float(m_last_value);
+    ++m_read;
+    return true;
+}
+
+bool Series_Decoder::_get_bits(uint8_t nbits, uint64_t * bits)
+{
+    if (m_bit + nbits > uint64_t(m_size) * 8)
+        return false;
+
+    *bits = 0;
+    for (uint8_t i = 0; i < nbits; ++i, ++m_bit)
+        *bits = (*bits << 1) | ((m_data[m_bit >> 3] >> (7 - (m_bit & 7))) & 1);
+    return true;
+}
+
+Series_Writer::Series_Writer(uint32_t chunk_points, uint32_t chunk_span_ms)
+    : m_chunk_points(std::min(std::max(chunk_points, uint32_t(1)), SERIES_MAX_CHUNK_POINTS)), m_chunk_span_ms(chunk_span_ms), m_series()
+{}
+
+void Series_Writer::append(const char * serial, uint8_t param, int64_t t_ms, float value, std::string * out)
+{
+    Series_Key key(serial, param);
+    Series_Encoder & enc = m_series[key];
+    if (enc.count() > 0 && t_ms - enc.first_ms() >= m_chunk_span_ms)
+        _seal(key, &enc, out);
+
+    if (!enc.append(t_ms, value))
+    {
+        _seal(key, &enc, out);
+        enc.append(t_ms, value);
+    }
+
+    if (enc.count() >= m_chunk_points)
+        _seal(key, &enc, out);
+}
+
+void Series_Writer::seal_expired(int64_t now_ms, std::string * out)
+{
+    auto iter = m_series.begin();
+    while (iter != m_series.end())
+    {
+        if (iter->second.count() > 0 && now_ms - iter->second.first_ms() >= m_chunk_span_ms)
+            _seal(iter->first, &iter->second, out);
+        ++iter;
+    }
+}
+
+void Series_Writer::seal_all(std::string * out)
+{
+    auto iter = m_series.begin();
+    while (iter != m_series.end())
+    {
+        if (iter->second.count() > 0)
+            _seal(iter->first, &iter->second, out);
+        ++iter;
+    }
+}
+
+uint32_t Series_Writer::pending() const
+{
+    uint32_t ret = 0;
+    auto iter = m_series.begin();
+    while (iter != m_series.end())
+    {
+        ret += iter->second.count();
+        ++iter;
+    }
+    return ret;
+}
+
+void Series_Writer::_seal(const Series_Key & key, Series_Encoder * enc, std::string * out)
+{
+    enc->write_chunk(key.first.c_str(), key.second, out);
+    enc->reset();
+}
+
+Series_Reader::Series_Reader() : m_file(nullptr), m_chunks(), m_payload(), m_truncated(false), m_error()
+{}
+
+Series_Reader::~Series_Reader()
+{
+    close();
+}
+
+bool Series_Reader::open(const std::string & fname)
+{
+    close();
+    m_file = fopen(fname.c_str(), "rb");
+    if (!m_file)
+    {
+        m_error = "could not open " + fname + ": " + strerror(errno);
+        return false;
+    }
+    return _read_index();
+}
+
+void Series_Reader::close()
+{
+    if (m_file)
+        fclose(m_file);
+    m_file = nullptr;
+    m_chunks.clear();
+    m_truncated = false;
+    m_error.clear();
+}
+
+bool Series_Reader::_read_index()
+{
+    fseek(m_file, 0, SEEK_END);
+    int64_t file_size = ftell(m_file);
+    fseek(m_file, 0, SEEK_SET);
+
+    int64_t offset = 0;
+    while (offset < file_size)
+    {
+        uint8_t header[SERIES_CHUNK_HEADER_SIZE];
+        if (offset + SERIES_CHUNK_HEADER_SIZE > file_size || fread(header, 1, SERIES_CHUNK_HEADER_SIZE, m_file) != SERIES_CHUNK_HEADER_SIZE)
+        {
+            m_truncated = true;
+            return true;
+        }
+        if (memcmp(header, SERIES_CHUNK_MAGIC, 4) != 0)
+        {
+            m_error = "bad chunk magic at offset " + std::to_string(offset) + " - not a series file or written with a different byte order";
+            return false;
+        }
+        if (header[4] != SERIES_VERSION)
+        {
+            m_error = "unsupported version " + std::to_string(header[4]) + " at offset " + std::to_string(offset);
+            return false;
+        }
+
+        Series_Chunk_Info info;
+        const uint8_t * cur = header + 5;
+        memcpy(info.serial, cur, SERIES_SERIAL_SIZE);
+        info.serial[SERIES_SERIAL_SIZE - 1] = 0;
+        cur += SERIES_SERIAL_SIZE;
+        info.param = *cur++;
+        cur = read_pod(cur, &info.count);
+        cur = read_pod(cur, &info.first_ms);
+        cur = read_pod(cur, &info.last_ms);
+        read_pod(cur, &info.size);
+        info.offset = offset + SERIES_CHUNK_HEADER_SIZE;
+
+        // Skip the payload - it is only read if a query needs it
+        if (info.offset + info.size > file_size)
+        {
+            m_truncated = true;
+            return true;
+        }
+        offset = info.offset + info.size;
+        fseek(m_file, offset, SEEK_SET);
+        m_chunks.push_back(info);
+    }
+    return true;
+}
+
+const std::vector<Series_Chunk_Info> & Series_Reader::chunks() const
+{
+    return m_chunks;
+}
+
+bool Series_Reader::query(const std::string & serial, uint8_t param, int64_t t0, int64_t t1, std::vector<Series_Point> * out)
+{
+    if (!m_file)
+    {
+        m_error = "no file open";
+        return false;
+    }
+
+    for (size_t i = 0; i < m_chunks.size(); ++i)
+    {
+        const Series_Chunk_Info & info = m_chunks[i];
+        if (info.param != param || info.last_ms < t0 || info.first_ms > t1 || serial.compare(info.serial) != 0)
+            continue;
+
+        m_payload.resize(info.size);
+        if (fseek(m_file, info.offset, SEEK_SET) != 0 || fread(m_payload.data(), 1, info.size, m_file) != info.size)
+        {
+            m_error = "could not read chunk at offset " + std::to_string(info.offset);
+            return false;
+        }
+
+        Series_Decoder dec(m_payload.data(), info.size, info.count, info.first_ms);
+        Series_Point pt;
+        while (dec.next(&pt))
+        {
+            if (pt.t_ms >= t0 && pt.t_ms <= t1)
+                out->push_back(pt);
+        }
+    }
+    return true;
+}
+
+bool Series_Reader::truncated() const
+{
+    return m_truncated;
+}
+
+const std::string & Series_Reader::error() const
+{
+    return m_error;
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <stdio.h>
+#include <map>
+#include <vector>
+
+#include "log_format.h"
+
+/*
+ Compressed per radio, per param time series (".rmts" files). A file is a sequence of chunks, each holding up to
+ a few hundred points of one series:
+
+   "RMTC", version (u8), serial (SERIES_SERIAL_SIZE chars, nul padded), param (u8), point count (u16),
+   first time (i64 ms since the epoch), last time (i64 ms), payload size (u32), payload
+
+ The payload is the Gorilla encoding of the points - the first value as is, then each timestamp as the delta of its
+ delta from the one before and each value as the XOR with the one before, packed in variable length bit fields so
+ a steady series costs a bit or two per point. The header doubles as the chunk's index entry - a reader only has to
+ hop from header to header to find the chunks for a time range of one series, and only decodes those.
+
+ Everything is in host byte order (little endian on the Pi and on x86). Spdlog free so the tools can use it.
+ */
+
+#define SERIES_FILE_EXTENSION ".rmts"
+#define SERIES_DEFAULT_CHUNK_POINTS 240
+#define SERIES_DEFAULT_CHUNK_SPAN_MS 600000
+
+const char SERIES_CHUNK_MAGIC[] = "RMTC";
+const uint8_t SERIES_VERSION = 1;
+const uint8_t SERIES_SERIAL_SIZE = 16;
+const uint32_t SERIES_CHUNK_HEADER_SIZE = 4 + 1 + SERIES_SERIAL_SIZE + 1 + 2 + 8 + 8 + 4;
+const uint32_t SERIES_MAX_CHUNK_POINTS = 65535;
+
+struct Series_Point
+{
+    int64_t t_ms;
+    float value;
+};
+
+/// A chunk header and where its payload is in the file
+struct Series_Chunk_Info
+{
+    Series_Chunk_Info();
+
+    char serial[SERIES_SERIAL_SIZE];
+    uint8_t param;
+    uint16_t count;
+    int64_t first_ms;
+    int64_t last_ms;
+    uint32_t size;
+    int64_t offset;
+};
+
+/// Packs points in to a chunk's payload one at a time
+class Series_Encoder
+{
+  public:
+    Series_Encoder();
+
+    /// Start a new (empty) chunk
+    void reset();
+
+    /// Returns false, adding nothing, if the point doesn't fit in this chunk (the chunk is full or the time jumped
+    /// too far) - write the chunk out and reset first
+    bool append(int64_t t_ms, float value);
+
+    uint32_t count() const;
+
+    int64_t first_ms() const;
+
+    int64_t last_ms() const;
+
+    /// Append the chunk (header and payload) for serial/param to out
+    void write_chunk(const char * serial, uint8_t param, std::string * out) const;
+
+  private:
+    void _put_bits(uint64_t bits, uint8_t nbits);
+
+    std::vector<uint8_t> m_bytes;
+    uint8_t m_free_bits;
+    uint32_t m_count;
+    int64_t m_first_ms;
+    int64_t m_last_ms;
+    int64_t m_last_delta;
+    uint32_t m_last_value;
+    uint8_t m_last_lead;
+    uint8_t m_last_trail;
+};
+
+/// Unpacks a chunk's payload
+class Series_Decoder
+{
+  public:
+    Series_Decoder(const uint8_t * data, uint32_t size, uint32_t count, int64_t first_ms);
+
+    /// False once all the points are read or the payload runs out
+    bool next(Series_Point * pt);
+
+  private:
+    bool _get_bits(uint8_t nbits, uint64_t * bits);
+
+    const uint8_t * m_data;
+    uint32_t m_size;
+    uint64_t m_bit;
+    uint32_t m_count;
+    uint32_t m_read;
+    int64_t m_last_ms;
+    int64_t m_last_delta;
+    uint32_t m_last_value;
+    uint8_t m_last_lead;
+    uint8_t m_last_trail;
+};
+
+/// Keeps an open chunk per series and hands back chunks as they fill up or get old enough to be written
+class Series_Writer
+{
+  public:
+    Series_Writer(uint32_t chunk_points = SERIES_DEFAULT_CHUNK_POINTS, uint32_t chunk_span_ms = SERIES_DEFAULT_CHUNK_SPAN_MS);
+
+    /// Add a point to the series for serial/param - appends the series' chunk to out if it had to be sealed
+    void append(const char * serial, uint8_t param, int64_t t_ms, float value, std::string * out);
+
+    /// Append every chunk whose first point is at least the chunk span older than now_ms
+    void seal_expired(int64_t now_ms, std::string * out);
+
+    /// Append every chunk with any points
+    void seal_all(std::string * out);
+
+    /// Points held in unsealed chunks
+    uint32_t pending() const;
+
+  private:
+    typedef std::pair<std::string, uint8_t> Series_Key;
+
+    void _seal(const Series_Key & key, Series_Encoder * enc, std::string * out);
+
+    uint32_t m_chunk_points;
+    uint32_t m_chunk_span_ms;
+    std::map<Series_Key, Series_Encoder> m_series;
+};
+
+/// Reads a series file - the chunk headers are read (and the payloads skipped) on open
+class Series_Reader
+{
+  public:
+    Series_Reader();
+    ~Series_Reader();
+
+    bool open(const std::string & fname);
+
+    void close();
+
+    /// Every complete chunk in the file in file order
+    const std::vector<Series_Chunk_Info> & chunks() const;
+
+    /// Append the points of serial/param with times from t0 to t1 (inclusive) to out, in file order - only chunks that
+    /// overlap the range are read
+    bool query(const std::string & serial, uint8_t param, int64_t t0, int64_t t1, std::vector<Series_Point> * out);
+
+    /// Set if the file ended part way through a chunk (ie power was lost while writing) - the chunks before it are fine
+    bool truncated() const;
+
+    const std::string & error() const;
+
+  private:
+    Series_Reader(const Series_Reader &);
+    Series_Reader & operator=(const Series_Reader &);
+
+    bool _read_index();
+
+    FILE * m_file;
+    std::vector<Series_Chunk_Info> m_chunks;
+    std::vector<uint8_t> m_payload;
+    bool m_truncated;
+    std::string m_error;
+};
@@ -1,11 +1,14 @@
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 
 #include "socket.h"
 #include "logger.h"
 
-Socket::Socket() : Threaded_Fd(), _port(0)
+Socket::Socket(const Fd_Buffer_Config & buf_cfg) : Threaded_Fd(buf_cfg), _port(0)
 {
     int32_t socket_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (socket_fd == -1)
@@ -17,6 +20,28 @@ Socket::Socket() : Threaded_Fd(), _port(0)
 }
 
 int Socket::connect(const std::string & ip_address, int16_t port, const Timeout_Interval & timeout_intv)
+{
+    int ret = begin_connect(ip_address, port);
+    if (ret == 0 || errno != EINPROGRESS)
+        return ret;
+
+    pollfd pfd = {};
+    pfd.fd = fd();
+    pfd.events = POLLOUT;
+    int cnt = poll(&pfd, 1, timeout_intv.to_ms());
+    if (cnt == 0)
+    {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+    else if (cnt < 0)
+    {
+        return -1;
+    }
+    return finish_connect();
+}
+
+int Socket::begin_connect(const std::string & ip_address, int16_t port)
 {
     _ip = ip_address;
     _port = port;
@@ -27,19 +52,40 @@ int Socket::connect(const std::string & ip_address, int16_t port, const Timeout_
     server_addr.sin_addr.s_addr = inet_addr(ip_address.c_str());
     server_addr.sin_port = htons(port);
 
-    struct timeval timeout;
-    timeout.tv_sec = timeout_intv.secs; // after 2 seconds connect() will timeout
-    timeout.tv_usec = timeout_intv.usecs;
-    setsockopt(fd(), SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    // All socket io is non-blocking anyways, and this lets connects be waited on with poll
+    int flags = fcntl(fd(), F_GETFL, 0);
+    fcntl(fd(), F_SETFL, flags | O_NONBLOCK);
 
     return ::connect(fd(), (struct sockaddr *)&server_addr, sizeof(server_addr));
 }
 
+int Socket::finish_connect()
+{
+    int32_t err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(fd(), SOL_SOCKET, SO_ERROR, &err, &len) != 0)
+        return -1;
+    if (err != 0)
+    {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
 Socket::~Socket()
 {
     stop();
 }
 
+Fd_Buffer_Config Socket::default_buffer_config()
+{
+    return Fd_Buffer_Config(DEFAULT_SOCKET_READ_BUFFER_SIZE,
+                            DEFAULT_SOCKET_WRITE_BUFFER_SIZE,
+                            DEFAULT_SOCKET_MAX_READ_BUFFER_SIZE,
+                            DEFAULT_SOCKET_MAX_WRITE_BUFFER_SIZE);
+}
+
 std::string & Socket::get_ip()
 {
     return _ip;
@@ -62,7 +108,11 @@ int32_t Socket::_raw_read(uint8_t * buffer, uint32_t max_size)
     return cnt;
 }
 
-int32_t Socket::_raw_write(uint8_t * buffer, uint32_t max_size)
+int32_t Socket::_raw_writev(const iovec * iov, int32_t iov_cnt)
 {
-    return ::write(m_fd, buffer, max_size);
+    // Never block the io thread and never take down the process with SIGPIPE if the radio hung up
+    msghdr msg = {};
+    msg.msg_iov = (iovec *)iov;
+    msg.msg_iovlen = iov_cnt;
+    return sendmsg(m_fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
 }
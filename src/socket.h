@@ -2,9 +2,16 @@
 
 #include "threaded_fd.h"
 
+// Radio responses are small - start the buffers small and let them grow if a burst needs it
+#define DEFAULT_SOCKET_READ_BUFFER_SIZE 2048
+#define DEFAULT_SOCKET_MAX_READ_BUFFER_SIZE 65536
+#define DEFAULT_SOCKET_WRITE_BUFFER_SIZE 256
+#define DEFAULT_SOCKET_MAX_WRITE_BUFFER_SIZE 5120
+
 struct Timeout_Interval
 {
     Timeout_Interval(uint32_t secs_, uint32_t microsecs_):secs(secs_), usecs(microsecs_) {}
+    int32_t to_ms() const {return secs * 1000 + usecs / 1000;}
     uint32_t secs;
     uint32_t usecs;
 };
@@ -13,18 +20,28 @@ class Socket : public Threaded_Fd
 {
   public:
 
-    Socket();
+    Socket(const Fd_Buffer_Config & buf_cfg = default_buffer_config());
 	~Socket();
 
+    static Fd_Buffer_Config default_buffer_config();
+
+    /// Connect and wait up to timeout for it to complete - returns 0 on success or -1 with errno set
     int connect(const std::string & ip_address, int16_t port, const Timeout_Interval & timeout);
 
+    /// Start a non-blocking connect - returns 0 if connected right away, otherwise -1 with errno set (EINPROGRESS
+    /// means the connect is under way and the fd will poll writable once it is done)
+    int begin_connect(const std::string & ip_address, int16_t port);
+
+    /// Once an in progress connect polls writable - returns 0 if it succeeded or -1 with errno set to the reason
+    int finish_connect();
+
     std::string & get_ip();
 
     int16_t get_port();
 
   private:
 	int32_t _raw_read(uint8_t * buffer, uint32_t max_size);
-	int32_t _raw_write(uint8_t * buffer, uint32_t max_size);
+	int32_t _raw_writev(const iovec * iov, int32_t iov_cnt);
 
     std::string _ip;
     int16_t _port;
@@ -0,0 +1,308 @@
+#pragma once
+
+#include <atomic>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SPSC_CACHE_LINE_SIZE 64
+
+/// Lock free single producer / single consumer ring buffer. Exactly one thread may push and exactly one (other)
+/// thread may pop - neither side ever blocks the other. The producer publishes with a release store of the tail
+/// index and the consumer frees space with a release store of the head index. Elements are copied in at most two
+/// contiguous memcpy spans so T must be trivially copyable. Indices run from 0 to twice the capacity so a full
+/// ring can be told apart from an empty one without wasting a slot, and any capacity (not just powers of 2) works.
+///
+/// The ring can grow on demand up to max_capacity. When a push doesn't fit the producer allocates a bigger segment
+/// and links it after the current one - the consumer drains the old segment, follows the link, and frees it. A
+/// single push never straddles two segments.
+template<class T>
+class Spsc_Ring
+{
+  public:
+    Spsc_Ring(uint32_t capacity = 0, uint32_t max_capacity = 0)
+        : m_pushed(0), m_popped(0), m_high_water(0), m_allocated(0), m_max_capacity(0), m_read_seg(nullptr), m_write_seg(nullptr)
+    {
+        resize(capacity, max_capacity);
+    }
+
+    ~Spsc_Ring()
+    {
+        _free_segments();
+    }
+
+    /// Not thread safe - only call when neither the producer or consumer are using the ring. Drops all contents.
+    /// A max_capacity less than capacity means the ring never grows.
+    void resize(uint32_t capacity, uint32_t max_capacity = 0)
+    {
+        _free_segments();
+        if (max_capacity < capacity)
+            max_capacity = capacity;
+        m_max_capacity = max_capacity;
+        m_read_seg = m_write_seg = new Segment(capacity);
+        m_allocated.store(capacity, std::memory_order_relaxed);
+        m_high_water.store(0, std::memory_order_relaxed);
+        clear();
+    }
+
+    /// Not thread safe - only call when neither the producer or consumer are using the ring. Keeps the largest
+    /// segment so a grown ring stays grown.
+    void clear()
+    {
+        while (m_read_seg != m_write_seg)
+        {
+            Segment * next = m_read_seg->next.load(std::memory_order_relaxed);
+            m_allocated.fetch_sub(m_read_seg->capacity, std::memory_order_relaxed);
+            delete m_read_seg;
+            m_read_seg = next;
+        }
+        if (m_write_seg)
+        {
+            m_write_seg->head.store(0, std::memory_order_relaxed);
+            m_write_seg->tail.store(0, std::memory_order_relaxed);
+        }
+        m_pushed.store(0, std::memory_order_relaxed);
+        m_popped.store(0, std::memory_order_relaxed);
+    }
+
+    /// Most elements the ring will ever hold
+    uint32_t capacity() const
+    {
+        return m_max_capacity;
+    }
+
+    /// Elements worth of memory currently allocated
+    uint32_t allocated() const
+    {
+        return m_allocated.load(std::memory_order_relaxed);
+    }
+
+    /// Most elements that have been in the ring at once since the last resize
+    uint32_t high_water() const
+    {
+        return m_high_water.load(std::memory_order_relaxed);
+    }
+
+    /// Exact when called from either the producer or consumer, otherwise just a snapshot
+    uint32_t size() const
+    {
+        return m_pushed.load(std::memory_order_acquire) - m_popped.load(std::memory_order_acquire);
+    }
+
+    uint32_t free_space() const
+    {
+        return m_max_capacity - size();
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    /// Producer only - push up to count elements and return how many actually fit
+    uint32_t push(const T * src, uint32_t count)
+    {
+        uint32_t pushed = m_pushed.load(std::memory_order_relaxed);
+        uint32_t used = pushed - m_popped.load(std::memory_order_acquire);
+        if (count > m_max_capacity - used)
+            count = m_max_capacity - used;
+        if (count == 0)
+            return 0;
+
+        Segment * seg = m_write_seg;
+        uint32_t tail = seg->tail.load(std::memory_order_relaxed);
+        uint32_t seg_free = seg->capacity - seg->distance(seg->head.load(std::memory_order_acquire), tail);
+        if (seg_free < count)
+        {
+            if (seg->capacity < m_max_capacity)
+            {
+                uint32_t cap = seg->capacity * 2;
+                if (cap < count)
+                    cap = count;
+                if (cap > m_max_capacity)
+                    cap = m_max_capacity;
+
+                Segment * grown = new Segment(cap);
+                m_allocated.fetch_add(cap, std::memory_order_relaxed);
+                seg->next.store(grown, std::memory_order_release);
+                m_write_seg = seg = grown;
+                tail = 0;
+                seg_free = cap;
+            }
+            if (count > seg_free)
+                count = seg_free;
+            if (count == 0)
+                return 0;
+        }
+
+        uint32_t pos = seg->position(tail);
+        uint32_t first = seg->capacity - pos;
+        if (first > count)
+            first = count;
+        memcpy(seg->buffer + pos, src, first * sizeof(T));
+        memcpy(seg->buffer, src + first, (count - first) * sizeof(T));
+        seg->tail.store(seg->advance(tail, count), std::memory_order_release);
+        m_pushed.store(pushed + count, std::memory_order_release);
+
+        if (used + count > m_high_water.load(std::memory_order_relaxed))
+            m_high_water.store(used + count, std::memory_order_relaxed);
+        return count;
+    }
+
+    /// Consumer only - copy up to max_count elements in to dest without removing them. Only looks at the front
+    /// segment so may return less than size() while the ring is growing.
+    uint32_t peek(T * dest, uint32_t max_count)
+    {
+        const T * spans[2];
+        uint32_t lens[2];
+        uint32_t count = read_spans(spans[0], lens[0], spans[1], lens[1]);
+        if (count > max_count)
+            count = max_count;
+        uint32_t first = (lens[0] < count) ? lens[0] : count;
+        memcpy(dest, spans[0], first * sizeof(T));
+        memcpy(dest + first, spans[1], (count - first) * sizeof(T));
+        return count;
+    }
+
+    /// Consumer only - remove up to max_count elements copying them in to dest
+    uint32_t pop(T * dest, uint32_t max_count)
+    {
+        uint32_t total = 0;
+        while (total < max_count)
+        {
+            uint32_t cnt = discard(peek(dest + total, max_count - total));
+            if (cnt == 0)
+                break;
+            total += cnt;
+        }
+        return total;
+    }
+
+    /// Consumer only - drop up to count elements from the front
+    uint32_t discard(uint32_t count)
+    {
+        uint32_t total = 0;
+        while (total < count)
+        {
+            Segment * seg = _front_segment();
+            uint32_t head = seg->head.load(std::memory_order_relaxed);
+            uint32_t avail = seg->distance(head, seg->tail.load(std::memory_order_acquire));
+            if (avail == 0)
+                break;
+            if (avail > count - total)
+                avail = count - total;
+            seg->head.store(seg->advance(head, avail), std::memory_order_release);
+            total += avail;
+        }
+        m_popped.store(m_popped.load(std::memory_order_relaxed) + total, std::memory_order_release);
+        return total;
+    }
+
+    /// Consumer only - get the readable elements of the front segment as (at most) two contiguous spans without
+    /// copying. Returns the total.
+    uint32_t read_spans(const T *& first, uint32_t & first_len, const T *& second, uint32_t & second_len)
+    {
+        Segment * seg = _front_segment();
+        uint32_t head = seg->head.load(std::memory_order_relaxed);
+        uint32_t count = seg->distance(head, seg->tail.load(std::memory_order_acquire));
+        first = second = seg->buffer;
+        first_len = second_len = 0;
+        if (count == 0)
+            return 0;
+
+        uint32_t pos = seg->position(head);
+        first = seg->buffer + pos;
+        first_len = seg->capacity - pos;
+        if (first_len > count)
+            first_len = count;
+        second_len = count - first_len;
+        return count;
+    }
+
+  private:
+    struct Segment
+    {
+        Segment(uint32_t capacity_) : head(0), tail(0), capacity(capacity_), buffer(nullptr), next(nullptr)
+        {
+            if (capacity > 0)
+                buffer = (T *)malloc(capacity * sizeof(T));
+        }
+
+        ~Segment()
+        {
+            free(buffer);
+        }
+
+        uint32_t distance(uint32_t head_, uint32_t tail_) const
+        {
+            return (tail_ >= head_) ? (tail_ - head_) : (tail_ + 2 * capacity - head_);
+        }
+
+        uint32_t position(uint32_t index) const
+        {
+            return (index >= capacity) ? (index - capacity) : index;
+        }
+
+        uint32_t advance(uint32_t index, uint32_t count) const
+        {
+            index += count;
+            if (index >= 2 * capacity)
+                index -= 2 * capacity;
+            return index;
+        }
+
+        // Keep the consumer and producer indices on separate cache lines so the two threads don't fight over them
+        std::atomic<uint32_t> head;
+        char pad_head[SPSC_CACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
+        std::atomic<uint32_t> tail;
+        char pad_tail[SPSC_CACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
+
+        uint32_t capacity;
+        T * buffer;
+        std::atomic<Segment *> next;
+    };
+
+    // Consumer side - move past (and free) drained segments the producer has already moved on from
+    Segment * _front_segment()
+    {
+        Segment * seg = m_read_seg;
+        while (true)
+        {
+            // Load next first - if it is set the producer is done with seg so its tail is final
+            Segment * next = seg->next.load(std::memory_order_acquire);
+            if (!next)
+                return seg;
+            if (seg->distance(seg->head.load(std::memory_order_relaxed), seg->tail.load(std::memory_order_acquire)) != 0)
+                return seg;
+            m_allocated.fetch_sub(seg->capacity, std::memory_order_relaxed);
+            delete seg;
+            m_read_seg = seg = next;
+        }
+    }
+
+    void _free_segments()
+    {
+        while (m_read_seg)
+        {
+            Segment * next = m_read_seg->next.load(std::memory_order_relaxed);
+            delete m_read_seg;
+            m_read_seg = next;
+        }
+        m_write_seg = nullptr;
+    }
+
+    Spsc_Ring(const Spsc_Ring &);
+    Spsc_Ring & operator=(const Spsc_Ring &);
+
+    std::atomic<uint32_t> m_pushed;
+    char m_pad_pushed[SPSC_CACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
+    std::atomic<uint32_t> m_popped;
+    char m_pad_popped[SPSC_CACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
+
+    std::atomic<uint32_t> m_high_water;
+    std::atomic<uint32_t> m_allocated;
+    uint32_t m_max_capacity;
+
+    Segment * m_read_seg;
+    Segment * m_write_seg;
+};
@@ -4,30 +4,54 @@
 #include <errno.h>
 #include <string.h>
 #include <sys/types.h>
+#include <sys/epoll.h>
+#include <algorithm>
 
 #include "timer.h"
+#include "fd_reactor.h"
 #include "callback.h"
 #include "threaded_fd.h"
 #include "utility.h"
 #include "logger.h"
+#include "config_file.h"
 
-Threaded_Fd::Threaded_Fd(uint32_t readbuf_, uint32_t writebuf_)
+bool fill_buffer_config_if_found(Config_File * cfg, const std::string & name, Fd_Buffer_Config * bcfg)
+{
+    nlohmann::json obj;
+    if (!cfg->fill_param_if_found(name, &obj))
+        return false;
+
+    try
+    {
+        fill_param_if_found(obj, "read_size", &bcfg->read_size);
+        fill_param_if_found(obj, "max_read_size", &bcfg->max_read_size);
+        fill_param_if_found(obj, "write_size", &bcfg->write_size);
+        fill_param_if_found(obj, "max_write_size", &bcfg->max_write_size);
+    }
+    catch (nlohmann::detail::exception & e)
+    {
+        elog("Error for buffer sizes is in parent json object {}", name);
+        return false;
+    }
+    return true;
+}
+
+Threaded_Fd::Threaded_Fd(const Fd_Buffer_Config & buf_cfg)
     : m_fd(-1),
-      m_read_rawindex(0),
-      m_read_curindex(0),
-      m_write_rawindex(0),
-      m_write_curindex(0),
-      write_buf_size_(writebuf_),
-      read_buf_size_(readbuf_),
+      m_write_buffer(buf_cfg.write_size, buf_cfg.max_write_size),
+      m_write_frames(_write_frame_count(buf_cfg.write_size), _write_frame_count(buf_cfg.max_write_size)),
+      m_read_buffer(buf_cfg.read_size, buf_cfg.max_read_size),
+      m_buf_cfg(buf_cfg),
       m_current_wait_for_byte_count(0),
       m_wait_timer(new Timer()),
-      m_thread(0)
+      m_frame_sent(0),
+      m_thread(0),
+      m_reactor(nullptr),
+      m_reactor_worker(-1),
+      m_write_armed(false),
+      m_notify_fd(-1)
 {
-    pthread_mutex_init(&m_send_lock, nullptr);
-    pthread_mutex_init(&m_recv_lock, nullptr);
     pthread_mutex_init(&m_error_lock, nullptr);
-    m_read_buffer = (uint8_t *)malloc(read_buf_size_);
-    m_write_buffer = (WriteVal *)malloc(write_buf_size_ * sizeof(WriteVal));
 
     m_wait_timer->set_callback_delay(COMMAND_WAIT_DELAY);
     m_wait_timer->set_callback_mode(Timer::single_shot);
@@ -39,11 +63,7 @@ Threaded_Fd::Threaded_Fd(uint32_t readbuf_, uint32_t writebuf_)
 
 Threaded_Fd::~Threaded_Fd()
 {
-    pthread_mutex_destroy(&m_send_lock);
-    pthread_mutex_destroy(&m_recv_lock);
     pthread_mutex_destroy(&m_error_lock);
-    free(m_read_buffer);
-    free(m_write_buffer);
     delete m_wait_timer;
     if (m_fd > 0)
         close(m_fd);
@@ -51,41 +71,30 @@ Threaded_Fd::~Threaded_Fd()
 
 uint32_t Threaded_Fd::read(uint8_t * buffer, uint32_t max_size)
 {
-    uint32_t count = 0;
-    pthread_mutex_lock(&m_recv_lock);
-    while (m_read_curindex != m_read_rawindex)
-    {
-        buffer[count] = m_read_buffer[m_read_curindex];
-        ++count;
-        ++m_read_curindex;
-        if (m_read_curindex == read_buf_size_)
-            m_read_curindex = 0;
-        if (count == max_size)
-            break;
-    }
-    pthread_mutex_unlock(&m_recv_lock);
-    return count;
+    return m_read_buffer.pop(buffer, max_size);
 }
 
 uint32_t Threaded_Fd::write(const uint8_t * buffer, uint32_t size, int32_t response_size)
 {
-    int32_t resp = 0;
-    pthread_mutex_lock(&m_send_lock);
-    if (size > write_buf_size_)
-        size = write_buf_size_;
-    for (uint32_t i = 0; i < size; ++i)
+    // Part of a message would be garbage to the other end and throw off the response accounting
+    if (size > m_write_buffer.capacity())
     {
-        if (i == size - 1)
-            resp = response_size;
-        m_write_buffer[m_write_curindex] = WriteVal(buffer[i], resp);
-        ++m_write_curindex;
-        if (m_write_curindex == m_write_rawindex)
-            size = i;
-        if (m_write_curindex == write_buf_size_)
-            m_write_curindex = 0;
+        elog("Dropping {} byte write on fd {} - bigger than the {} byte write buffer", size, int32_t(m_fd), m_write_buffer.capacity());
+        return 0;
     }
-    pthread_mutex_unlock(&m_send_lock);
-    return size;
+    if (size == 0 || m_write_frames.free_space() == 0 || m_write_buffer.free_space() < size)
+        return 0;
+
+    // Bytes go in first - the io thread only looks at bytes that a published frame header covers
+    m_write_buffer.push(buffer, size);
+    Write_Frame frame(size, response_size);
+    m_write_frames.push(&frame, 1);
+    uint32_t written = size;
+
+    // Let the reactor know there is something to write - only the first writer since the last drain needs to
+    if (m_reactor && written > 0 && !m_write_armed.exchange(true))
+        m_reactor->_watch_write(this, true);
+    return written;
 }
 
 uint32_t Threaded_Fd::write(const char * buffer, int32_t response_size)
@@ -121,6 +130,8 @@ void Threaded_Fd::_setError(ErrorVal err_val, int32_t _errno)
     m_err.err_val = err_val;
     m_err._errno = _errno;
     pthread_mutex_unlock(&m_error_lock);
+    if (err_val != NoError)
+        util::signal_event_fd(m_notify_fd);
 }
 
 bool Threaded_Fd::start()
@@ -134,6 +145,18 @@ bool Threaded_Fd::start()
 
     // Make sure to set before creating the thread!!
     m_thread_running.test_and_set();
+    if (m_reactor)
+    {
+        if (!m_reactor->add(this))
+        {
+            _setError(Registration, errno);
+            m_thread_running.clear();
+            return false;
+        }
+        _setError(NoError, 0);
+        return true;
+    }
+
     if (pthread_create(&m_thread, nullptr, Threaded_Fd::thread_exec, (void *)this) != 0)
     {
         _setError(ThreadCreation, errno);
@@ -157,22 +180,83 @@ bool Threaded_Fd::set_fd(int32_t fd_)
     return true;
 }
 
+bool Threaded_Fd::set_buffer_config(const Fd_Buffer_Config & buf_cfg)
+{
+    if (running())
+    {
+        _setError(AlreadyRunning, 0);
+        return false;
+    }
+    m_buf_cfg = buf_cfg;
+    m_write_buffer.resize(buf_cfg.write_size, buf_cfg.max_write_size);
+    m_write_frames.resize(_write_frame_count(buf_cfg.write_size), _write_frame_count(buf_cfg.max_write_size));
+    m_read_buffer.resize(buf_cfg.read_size, buf_cfg.max_read_size);
+    m_frame_sent = 0;
+    return true;
+}
+
+const Fd_Buffer_Config & Threaded_Fd::buffer_config()
+{
+    return m_buf_cfg;
+}
+
+Fd_Buffer_Stats Threaded_Fd::buffer_stats()
+{
+    Fd_Buffer_Stats ret;
+    ret.read_allocated = m_read_buffer.allocated();
+    ret.read_high_water = m_read_buffer.high_water();
+    ret.read_capacity = m_read_buffer.capacity();
+    ret.write_allocated = m_write_buffer.allocated() + m_write_frames.allocated() * sizeof(Write_Frame);
+    ret.write_high_water = m_write_buffer.high_water();
+    ret.write_capacity = m_write_buffer.capacity();
+    return ret;
+}
+
+uint32_t Threaded_Fd::_write_frame_count(uint32_t write_size)
+{
+    return std::max<uint32_t>(write_size / FD_WRITE_BYTES_PER_FRAME, FD_MIN_WRITE_FRAME_COUNT);
+}
+
+void Threaded_Fd::set_reactor(Fd_Reactor * reactor)
+{
+    m_reactor = reactor;
+}
+
+Fd_Reactor * Threaded_Fd::reactor()
+{
+    return m_reactor;
+}
+
+void Threaded_Fd::set_notify_fd(int32_t efd)
+{
+    m_notify_fd = efd;
+}
+
 void Threaded_Fd::stop()
 {
-    ilog("Stopping thread for fd {}", m_fd);
-    if (m_thread_running.test_and_set())
+    if (m_reactor)
     {
+        ilog("Removing fd {} from reactor", m_fd);
         m_thread_running.clear();
+        m_reactor->remove(this);
     }
     else
     {
-        ilog("Thread for fd {} already complete or never started (this is fine)", m_fd);
+        ilog("Stopping thread for fd {}", m_fd);
+        if (m_thread_running.test_and_set())
+        {
+            m_thread_running.clear();
+        }
+        else
+        {
+            ilog("Thread for fd {} already complete or never started (this is fine)", m_fd);
+        }
+        pthread_join(m_thread, nullptr);
     }
-    pthread_join(m_thread, nullptr);
-    m_read_rawindex = 0;
-    m_read_curindex = 0;
-    m_write_rawindex = 0;
-    m_write_curindex = 0;
+    m_read_buffer.clear();
+    m_write_buffer.clear();
+    m_write_frames.clear();
+    m_frame_sent = 0;
     m_current_wait_for_byte_count = 0;
 }
 
@@ -187,73 +271,93 @@ void Threaded_Fd::_do_read()
             _setError(InvalidRead, err_no);
             m_thread_running.clear();
         }
+        return;
     }
-    pthread_mutex_lock(&m_recv_lock);
-    for (int32_t i = 0; i < cnt; ++i)
-    {
-        m_read_buffer[m_read_rawindex] = m_tmp_read_buf[i];
-        ++m_read_rawindex;
-
-        if (m_current_wait_for_byte_count > 0)
-        {
-            --m_current_wait_for_byte_count;
-            if (m_current_wait_for_byte_count == 0 && m_wait_timer->running())
-                m_wait_timer->stop();
-        }
 
-        if (m_read_rawindex == read_buf_size_)
-            m_read_rawindex = 0;
+    if (m_current_wait_for_byte_count > 0)
+    {
+        if (uint32_t(cnt) >= m_current_wait_for_byte_count)
+            m_current_wait_for_byte_count = 0;
+        else
+            m_current_wait_for_byte_count -= cnt;
+        if (m_current_wait_for_byte_count == 0 && m_wait_timer->running())
+            m_wait_timer->stop();
+    }
 
-        // This check may go away eventually
-        if (m_read_rawindex == m_read_curindex)
-        {
-            _setError(InvalidRead, 0);
-            m_thread_running.clear();
-        }
+    // This check may go away eventually
+    if (m_read_buffer.push(m_tmp_read_buf, cnt) != uint32_t(cnt))
+    {
+        _setError(InvalidRead, 0);
+        m_thread_running.clear();
+    }
+    else if (cnt > 0)
+    {
+        util::signal_event_fd(m_notify_fd);
     }
-    pthread_mutex_unlock(&m_recv_lock);
 }
 
 void Threaded_Fd::_do_write()
 {
-    int32_t tosend = 0;
-    int32_t retval = 0;
-    int32_t sent = 0;
-
-    pthread_mutex_lock(&m_send_lock);
-    while (m_write_rawindex != m_write_curindex)
+    // Gather every complete frame up to (and including) the first that expects a response - the frame bytes are
+    // contiguous in the byte buffer so this is at most two iovecs no matter how many frames go out
+    Write_Frame frames[FD_MAX_WRITE_FRAMES_PER_CALL];
+    uint32_t frame_cnt = m_write_frames.peek(frames, FD_MAX_WRITE_FRAMES_PER_CALL);
+    if (frame_cnt == 0)
+        return;
+
+    uint32_t total = 0;
+    uint32_t use_frames = 0;
+    while (use_frames < frame_cnt)
     {
-        WriteVal wv = m_write_buffer[m_write_rawindex];
-        m_tmp_write_buf[tosend] = wv.byte;
-        m_current_wait_for_byte_count = wv.response_size;
-
-        ++m_write_rawindex;
-        ++tosend;
-
-        if (m_write_rawindex == write_buf_size_)
-            m_write_rawindex = 0;
-
-        if (m_current_wait_for_byte_count > 0)
-        {
-            m_wait_timer->start();
-            break;
-        }
-
-        if (tosend == FD_TMP_BUFFER_SIZE)
+        total += frames[use_frames].size;
+        ++use_frames;
+        if (frames[use_frames - 1].response_size > 0)
             break;
     }
-    pthread_mutex_unlock(&m_send_lock);
+    total -= m_frame_sent;
+
+    const uint8_t * spans[2];
+    uint32_t lens[2];
+    m_write_buffer.read_spans(spans[0], lens[0], spans[1], lens[1]);
+    iovec iov[2];
+    int32_t iov_cnt = 0;
+    for (int i = 0; i < 2 && total > 0; ++i)
+    {
+        uint32_t len = std::min(lens[i], total);
+        iov[iov_cnt].iov_base = (void *)spans[i];
+        iov[iov_cnt].iov_len = len;
+        total -= len;
+        ++iov_cnt;
+    }
 
-    while (sent != tosend)
+    int32_t retval = _raw_writev(iov, iov_cnt);
+    if (retval == -1)
     {
-        retval = _raw_write(m_tmp_write_buf + sent, tosend - sent);
-        if (retval == -1)
+        int32_t err_no = errno;
+        // Non-blocking fd is full - the rest goes out next time around
+        if (err_no != EAGAIN && err_no != EWOULDBLOCK)
         {
-            _setError(InvalidWrite, errno);
+            _setError(InvalidWrite, err_no);
             m_thread_running.clear();
         }
-        sent += retval;
+        return;
+    }
+    m_write_buffer.discard(retval);
+
+    // Retire the frames that are completely out
+    uint32_t sent = m_frame_sent + retval;
+    uint32_t done_frames = 0;
+    while (done_frames < use_frames && sent >= frames[done_frames].size)
+    {
+        sent -= frames[done_frames].size;
+        m_current_wait_for_byte_count = frames[done_frames].response_size;
+        ++done_frames;
     }
+    m_write_frames.discard(done_frames);
+    m_frame_sent = sent;
+
+    if (m_current_wait_for_byte_count > 0)
+        m_wait_timer->start();
 }
 
 void Threaded_Fd::_exec()
@@ -269,6 +373,43 @@ void Threaded_Fd::_exec()
     m_thread_running.clear();
 }
 
+void Threaded_Fd::_service(uint32_t events)
+{
+    m_wait_timer->update();
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        _do_read();
+    if (!m_wait_timer->running())
+        _do_write();
+}
+
+bool Threaded_Fd::_waiting_for_response()
+{
+    return m_wait_timer->running();
+}
+
+bool Threaded_Fd::_write_pending()
+{
+    return !m_write_frames.empty();
+}
+
+void Threaded_Fd::_update_write_interest()
+{
+    bool want_write = !m_wait_timer->running() && _write_pending();
+    if (want_write)
+    {
+        if (!m_write_armed.exchange(true))
+            m_reactor->_watch_write(this, true);
+    }
+    else if (m_write_armed)
+    {
+        // Clear the flag after disarming, then check again so a write() that raced with us is not stranded
+        m_reactor->_watch_write(this, false);
+        m_write_armed = false;
+        if (!m_wait_timer->running() && _write_pending() && !m_write_armed.exchange(true))
+            m_reactor->_watch_write(this, true);
+    }
+}
+
 void * Threaded_Fd::thread_exec(void * _this)
 {
     Threaded_Fd * thfd = static_cast<Threaded_Fd *>(_this);
@@ -320,6 +461,19 @@ std::string Threaded_Fd::error_string(const Threaded_Fd::Error & err)
     case (Threaded_Fd::CommandNoResponse):
         ret += "No response to command";
         break;
+    case (Threaded_Fd::Registration):
+        ret += "Could not register with reactor";
+        break;
     }
     return ret;
 }
+
+std::string Threaded_Fd::buffer_stats_string(const Fd_Buffer_Stats & stats)
+{
+    std::string ret;
+    ret += "read: " + std::to_string(stats.read_allocated) + " bytes allocated of " + std::to_string(stats.read_capacity) + " max (high water " +
+           std::to_string(stats.read_high_water) + ")";
+    ret += "  write: " + std::to_string(stats.write_allocated) + " bytes allocated of " + std::to_string(stats.write_capacity) +
+           " max (high water " + std::to_string(stats.write_high_water) + ")";
+    return ret;
+}
@@ -1,18 +1,60 @@
 #pragma once
 
 #include <pthread.h>
+#include <sys/uio.h>
 #include <vector>
 #include <string>
 #include <atomic>
 
 #include "callback.h"
+#include "spsc_ring.h"
 
 #define DEFAULT_FD_WRITE_BUFFER_SIZE 5120
 #define DEFAULT_FD_READ_BUFFER_SIZE 600000
 #define FD_TMP_BUFFER_SIZE 1024
+#define FD_WRITE_BYTES_PER_FRAME 32
+#define FD_MIN_WRITE_FRAME_COUNT 8
+#define FD_MAX_WRITE_FRAMES_PER_CALL 64
 #define COMMAND_WAIT_DELAY 1
 
 class Timer;
+class Fd_Reactor;
+class Config_File;
+
+/// Initial and max sizes (in bytes) for a Threaded_Fd's read and write buffers - the buffers start out at the
+/// initial size and grow on demand up to the max. A max smaller than the initial size means no growth.
+struct Fd_Buffer_Config
+{
+    Fd_Buffer_Config(uint32_t read_size_ = DEFAULT_FD_READ_BUFFER_SIZE,
+                     uint32_t write_size_ = DEFAULT_FD_WRITE_BUFFER_SIZE,
+                     uint32_t max_read_size_ = 0,
+                     uint32_t max_write_size_ = 0)
+        : read_size(read_size_), write_size(write_size_), max_read_size(max_read_size_), max_write_size(max_write_size_)
+    {}
+
+    uint32_t read_size;
+    uint32_t write_size;
+    uint32_t max_read_size;
+    uint32_t max_write_size;
+};
+
+/// Memory use of a Threaded_Fd's buffers in bytes - the high water marks are the most that was ever queued at once
+struct Fd_Buffer_Stats
+{
+    Fd_Buffer_Stats() : read_allocated(0), read_high_water(0), read_capacity(0), write_allocated(0), write_high_water(0), write_capacity(0)
+    {}
+
+    uint32_t read_allocated;
+    uint32_t read_high_water;
+    uint32_t read_capacity;
+    uint32_t write_allocated;
+    uint32_t write_high_water;
+    uint32_t write_capacity;
+};
+
+/// Fill bcfg from the json object name (with keys read_size, max_read_size, write_size, max_write_size) - keys
+/// not present are left as is
+bool fill_buffer_config_if_found(Config_File * cfg, const std::string & name, Fd_Buffer_Config * bcfg);
 
 class Threaded_Fd
 {
@@ -28,7 +70,8 @@ class Threaded_Fd
         OpenFileDescriptor,
         Configuration,
         AlreadyRunning,
-        CommandNoResponse
+        CommandNoResponse,
+        Registration
     };
 
     struct Error
@@ -40,20 +83,23 @@ class Threaded_Fd
         int32_t _errno;
     };
 
-    struct WriteVal
+    /// Header for one queued message - the message bytes themselves live contiguously in the write byte buffer
+    struct Write_Frame
     {
-        WriteVal(uint8_t byte_ = 0x00, int32_t response_size_ = 0) : byte(byte_), response_size(response_size_)
+        Write_Frame(uint32_t size_ = 0, int32_t response_size_ = 0) : size(size_), response_size(response_size_)
         {}
-        uint8_t byte;
+        uint32_t size;
         int32_t response_size;
     };
 
-    Threaded_Fd(uint32_t readbuf_size = DEFAULT_FD_READ_BUFFER_SIZE, uint32_t writebuf_size = DEFAULT_FD_WRITE_BUFFER_SIZE);
+    Threaded_Fd(const Fd_Buffer_Config & buf_cfg = Fd_Buffer_Config());
 
     virtual ~Threaded_Fd();
 
     virtual uint32_t read(uint8_t * buffer, uint32_t max_size);
 
+    /// Queue the whole message or nothing - returns the number of bytes queued (0 if the write buffer is full or the
+    /// message is bigger than the write buffer can ever hold)
     virtual uint32_t write(const uint8_t * buffer, uint32_t size, int32_t response_size = 0);
 
     virtual uint32_t write(const char * buffer, int32_t response_size = 0);
@@ -68,52 +114,82 @@ class Threaded_Fd
 
     bool set_fd(int32_t fd_);
 
+    /// Resize the read/write buffers - fails if running
+    bool set_buffer_config(const Fd_Buffer_Config & buf_cfg);
+
+    const Fd_Buffer_Config & buffer_config();
+
+    Fd_Buffer_Stats buffer_stats();
+
     void stop();
 
+    /// If a reactor is set, start() registers the fd with it instead of creating a thread for it
+    void set_reactor(Fd_Reactor * reactor);
+
+    Fd_Reactor * reactor();
+
+    /// eventfd to signal whenever new data has been read or an error is set (ie Main_Control::wake_fd) - -1 for none
+    void set_notify_fd(int32_t efd);
+
     static std::string error_string(const Error & err);
 
+    static std::string buffer_stats_string(const Fd_Buffer_Stats & stats);
+
   protected:
     friend struct command_wait_callback;
+    friend class Fd_Reactor;
 
     virtual int32_t _raw_read(uint8_t * buffer, uint32_t max_size) = 0;
-    virtual int32_t _raw_write(uint8_t * buffer, uint32_t max_size) = 0;
+    virtual int32_t _raw_writev(const iovec * iov, int32_t iov_cnt) = 0;
 
     void wait_callback_func(Timer * timer);
 
+    static uint32_t _write_frame_count(uint32_t write_size);
+
     virtual void _do_read();
     virtual void _do_write();
 
     virtual void _exec();
     void _setError(ErrorVal err_val, int32_t _errno);
 
+    // Called by the reactor worker this fd is registered with
+    void _service(uint32_t events);
+    bool _waiting_for_response();
+    bool _write_pending();
+    void _update_write_interest();
+
     static void * thread_exec(void *);
 
     std::atomic_int_fast32_t m_fd;
-    uint32_t m_read_rawindex;
-    uint32_t m_read_curindex;
-    uint32_t m_write_rawindex;
-    uint32_t m_write_curindex;
 
-    WriteVal * m_write_buffer;
-    uint8_t * m_read_buffer;
-    uint32_t write_buf_size_;
-    uint32_t read_buf_size_;
+    // The io thread is the only producer of the read buffer and only consumer of the write buffer - whoever calls
+    // read() and write() is the other side
+    Spsc_Ring<uint8_t> m_write_buffer;
+    Spsc_Ring<Write_Frame> m_write_frames;
+    Spsc_Ring<uint8_t> m_read_buffer;
+    Fd_Buffer_Config m_buf_cfg;
 
     Error m_err;
 
     uint32_t m_current_wait_for_byte_count;
     Timer * m_wait_timer;
 
-    pthread_mutex_t m_send_lock;
-    pthread_mutex_t m_recv_lock;
     pthread_mutex_t m_error_lock;
 
     uint8_t m_tmp_read_buf[FD_TMP_BUFFER_SIZE];
-    uint8_t m_tmp_write_buf[FD_TMP_BUFFER_SIZE];
+
+    // Bytes of the front write frame already sent (non-blocking fds can take part of a frame)
+    uint32_t m_frame_sent;
 
     std::atomic_flag m_thread_running = ATOMIC_FLAG_INIT;
 
     pthread_t m_thread;
+
+    Fd_Reactor * m_reactor;
+    std::atomic_int_fast32_t m_reactor_worker;
+    std::atomic_bool m_write_armed;
+
+    int32_t m_notify_fd;
 };
 
 struct command_wait_callback : public Wait_Ready_Callback
@@ -0,0 +1,84 @@
+#include <cmath>
+#include <limits>
+
+#include "trigger_eval.h"
+
+static const float NEVER = std::numeric_limits<float>::infinity();
+
+Float_Trigger::Float_Trigger() : change(NEVER), percent_change(NEVER), less_than(-NEVER), greater_than(NEVER), inside_band(false)
+{}
+
+Status_Trigger::Status_Trigger() : change(0), equal(0), equal_mask(0)
+{}
+
+void eval_float_trigger(const Float_Trigger & trig,
+                        const float * cur,
+                        const float * prev,
+                        const uint8_t * kind,
+                        uint8_t kind_match,
+                        float eps,
+                        uint32_t count,
+                        uint8_t * triggers)
+{
+    const float change_th = trig.change;
+    const float percent_th = trig.percent_change;
+    const float lt = trig.less_than;
+    const float gt = trig.greater_than;
+
+    // The band test is the same for every row - pick the loop once rather than per row
+    if (trig.inside_band)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            float c = cur[i];
+            float change = std::fabs(c - prev[i]);
+            // percent > percent_th without the divide - keeps the loop free of anything that could trap
+            float denom = (change >= eps) ? std::fabs(c) : 1.0f;
+            uint8_t changed = (change > change_th) | ((change * 100.0f) > (percent_th * denom));
+            uint8_t level = (c < lt) & (c > gt);
+            uint8_t bits = (changed * TRIGGER_CHANGE) | (level * TRIGGER_LEVEL);
+            triggers[i] |= bits * (kind[i] == kind_match);
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            float c = cur[i];
+            float change = std::fabs(c - prev[i]);
+            // percent > percent_th without the divide - keeps the loop free of anything that could trap
+            float denom = (change >= eps) ? std::fabs(c) : 1.0f;
+            uint8_t changed = (change > change_th) | ((change * 100.0f) > (percent_th * denom));
+            uint8_t level = (c < lt) | (c > gt);
+            uint8_t bits = (changed * TRIGGER_CHANGE) | (level * TRIGGER_LEVEL);
+            triggers[i] |= bits * (kind[i] == kind_match);
+        }
+    }
+}
+
+void eval_status_trigger(const Status_Trigger & trig,
+                         const uint8_t * cur,
+                         const uint8_t * prev,
+                         const uint8_t * kind,
+                         uint8_t kind_match,
+                         uint32_t count,
+                         uint8_t * triggers)
+{
+    const uint8_t change_on = trig.change;
+    const uint8_t mask = trig.equal_mask;
+    const uint8_t equal_on = trig.equal;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint8_t c = cur[i];
+        uint8_t changed = change_on & (c != prev[i]);
+        uint8_t level = equal_on & ((mask & c) == c);
+        uint8_t bits = (changed * TRIGGER_CHANGE) | (level * TRIGGER_LEVEL);
+        triggers[i] |= bits * (kind[i] == kind_match);
+    }
+}
+
+void eval_value_change(const float * cur, const float * prev, float eps, uint32_t count, uint8_t * triggers)
+{
+    for (uint32_t i = 0; i < count; ++i)
+        triggers[i] |= TRIGGER_CHANGE * (std::fabs(cur[i] - prev[i]) >= eps);
+}
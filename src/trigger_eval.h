@@ -0,0 +1,64 @@
+#pragma once
+
+#include <inttypes.h>
+
+// What a logger found for a radio - a change from its logged state, or a condition on the current values
+const uint8_t TRIGGER_CHANGE = 1;
+const uint8_t TRIGGER_LEVEL = 2;
+
+/// A float param's logger conditions as plain thresholds - a disabled condition gets a threshold it can never cross
+/// so the kernels need no per condition branches
+struct Float_Trigger
+{
+    Float_Trigger();
+
+    float change;
+    float percent_change;
+    float less_than;
+    float greater_than;
+
+    // Both bounds set with less_than above greater_than means inside the band rather than outside it
+    bool inside_band;
+};
+
+/// A status param's logger conditions
+struct Status_Trigger
+{
+    Status_Trigger();
+
+    // 1 if any change triggers
+    uint8_t change;
+
+    // 1 if the status being in equal_mask triggers
+    uint8_t equal;
+    uint8_t equal_mask;
+};
+
+/*
+ The kernels below run over one param's column for every radio at once and OR TRIGGER_* bits in to triggers - one
+ entry per radio. Only rows where kind[i] == kind_match are looked at (the rest are the other radio type). They are
+ written as simple branch free loops over contiguous arrays so the compiler vectorizes them (SSE/NEON) at -O3 - the
+ float ones also need -fno-trapping-math, which CMakeLists.txt sets for this file - and they run as plain scalar loops
+ anywhere it can't.
+ */
+
+/// Changes smaller than eps count as no change for percent_change
+void eval_float_trigger(const Float_Trigger & trig,
+                        const float * cur,
+                        const float * prev,
+                        const uint8_t * kind,
+                        uint8_t kind_match,
+                        float eps,
+                        uint32_t count,
+                        uint8_t * triggers);
+
+void eval_status_trigger(const Status_Trigger & trig,
+                         const uint8_t * cur,
+                         const uint8_t * prev,
+                         const uint8_t * kind,
+                         uint8_t kind_match,
+                         uint32_t count,
+                         uint8_t * triggers);
+
+/// TRIGGER_CHANGE for every row where cur and prev differ by eps or more
+void eval_value_change(const float * cur, const float * prev, float eps, uint32_t count, uint8_t * triggers);
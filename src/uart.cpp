@@ -7,8 +7,8 @@
 #include "uart.h"
 #include "logger.h"
 
-Uart::Uart(SerialPort uart_num):
-	Threaded_Fd(),
+Uart::Uart(SerialPort uart_num, const Fd_Buffer_Config & buf_cfg):
+	Threaded_Fd(buf_cfg),
 	m_df(),
 	m_baud(b115200)
 {
@@ -39,6 +39,14 @@ bool Uart::start()
 Uart::~Uart()
 {}
 
+Fd_Buffer_Config Uart::default_buffer_config()
+{
+	return Fd_Buffer_Config(DEFAULT_UART_READ_BUFFER_SIZE,
+	                        DEFAULT_UART_WRITE_BUFFER_SIZE,
+	                        DEFAULT_UART_MAX_READ_BUFFER_SIZE,
+	                        DEFAULT_UART_MAX_WRITE_BUFFER_SIZE);
+}
+
 const std::string & Uart::device_path()
 {
 	return m_devpath;
@@ -115,7 +123,7 @@ int32_t Uart::_raw_read(uint8_t * buffer, uint32_t max_size)
     return ::read(m_fd, buffer, max_size);
 }
 
-int32_t Uart::_raw_write(uint8_t * buffer, uint32_t max_size)
+int32_t Uart::_raw_writev(const iovec * iov, int32_t iov_cnt)
 {
-	return ::write(m_fd, buffer, max_size);
+	return ::writev(m_fd, iov, iov_cnt);
 }
@@ -3,6 +3,12 @@
 #include <termios.h>
 #include "threaded_fd.h"
 
+// Firmware uploads come in over the uart so let the read buffer grow big enough to hold a whole image
+#define DEFAULT_UART_READ_BUFFER_SIZE 4096
+#define DEFAULT_UART_MAX_READ_BUFFER_SIZE DEFAULT_FD_READ_BUFFER_SIZE
+#define DEFAULT_UART_WRITE_BUFFER_SIZE 1024
+#define DEFAULT_UART_MAX_WRITE_BUFFER_SIZE DEFAULT_FD_WRITE_BUFFER_SIZE
+
 class Uart : public Threaded_Fd
 {
   public:
@@ -81,9 +87,11 @@ class Uart : public Threaded_Fd
 		StopBits sb;
 	};
 
-	Uart(SerialPort uart_num);
+	Uart(SerialPort uart_num, const Fd_Buffer_Config & buf_cfg = default_buffer_config());
 	~Uart();
 
+	static Fd_Buffer_Config default_buffer_config();
+
 	const std::string & device_path();
 
 	void set_baud(BaudRate baud);
@@ -98,7 +106,7 @@ class Uart : public Threaded_Fd
   private:
 
 	int32_t _raw_read(uint8_t * buffer, uint32_t max_size);
-	int32_t _raw_write(uint8_t * buffer, uint32_t max_size);
+	int32_t _raw_writev(const iovec * iov, int32_t iov_cnt);
 
 	void _set_attribs();
 
@@ -8,6 +8,7 @@
 #include <pwd.h>
 #include <libgen.h>
 #include <linux/limits.h>
+#include <string.h>
 
 #include "logger.h"
 #include "utility.h"
@@ -56,6 +57,26 @@ bool path_exists(const std::string & name)
     return (stat(name.c_str(), &buffer) == 0);
 }
 
+int64_t file_size(const std::string & name)
+{
+    struct stat buffer;
+    if (stat(name.c_str(), &buffer) != 0)
+        return -1;
+    return buffer.st_size;
+}
+
+time_t next_local_midnight(time_t t)
+{
+    tm ltm;
+    localtime_r(&t, &ltm);
+    ltm.tm_sec = 0;
+    ltm.tm_min = 0;
+    ltm.tm_hour = 0;
+    ltm.tm_mday += 1;
+    ltm.tm_isdst = -1;
+    return mktime(&ltm);
+}
+
 bool save_data_to_file(uint8_t * data, uint32_t size, const char * fname, int mode_flags)
 {
     int fd = open(fname, O_RDWR | O_CREAT, mode_flags);
@@ -214,4 +235,74 @@ uint32_t hash_id(const char * str)
     return hash;
 }
 
+void signal_event_fd(int32_t efd)
+{
+    if (efd == -1)
+        return;
+    uint64_t val = 1;
+    ::write(efd, &val, sizeof(val));
+}
+
+double monotonic_ms()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+int64_t wall_ms()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return int64_t(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+Delimiter_Matcher::Delimiter_Matcher(const char * delim) : m_delim{0}, m_fail{0}, m_len(0), m_matched(0)
+{
+    size_t len = strlen(delim);
+    if (len > DELIMITER_MAX_LEN)
+        len = DELIMITER_MAX_LEN;
+    m_len = uint8_t(len);
+    memcpy(m_delim, delim, m_len);
+
+    // m_fail[i] is the length of the longest proper prefix of the delimiter that is also a suffix of its first i+1 chars
+    uint8_t k = 0;
+    for (uint8_t i = 1; i < m_len; ++i)
+    {
+        while (k > 0 && m_delim[i] != m_delim[k])
+            k = m_fail[k - 1];
+        if (m_delim[i] == m_delim[k])
+            ++k;
+        m_fail[i] = k;
+    }
+}
+
+uint32_t Delimiter_Matcher::scan(const uint8_t * data, uint32_t size, bool * found)
+{
+    *found = false;
+    if (m_len == 0)
+        return size;
+
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        char c = data[i];
+        while (m_matched > 0 && c != m_delim[m_matched])
+            m_matched = m_fail[m_matched - 1];
+        if (c == m_delim[m_matched])
+            ++m_matched;
+        if (m_matched == m_len)
+        {
+            m_matched = 0;
+            *found = true;
+            return i + 1;
+        }
+    }
+    return size;
+}
+
+void Delimiter_Matcher::reset()
+{
+    m_matched = 0;
+}
+
 } // namespace util
\ No newline at end of file
@@ -36,6 +36,12 @@ void delay(double ms);
 
 bool path_exists(const std::string & name);
 
+/// Size of the file in bytes, or -1 if it doesn't exist
+int64_t file_size(const std::string & name);
+
+/// Start of the next day (local time) after t
+time_t next_local_midnight(time_t t);
+
 std::string get_home_dir(const std::vector<std::string> & username_try_vec);
 
 /// Get the count of files in the dir - ignores . and ..
@@ -49,6 +55,40 @@ uint16_t filenames_in_dir(const char * dir, char **& buffer);
 
 std::string get_exe_dir();
 
+/// Add one to the eventfd efd so whoever is waiting on it wakes up - does nothing for -1, and is safe to call from
+/// any thread or a signal handler
+void signal_event_fd(int32_t efd);
+
+/// Milliseconds on the monotonic clock - only useful for measuring intervals
+double monotonic_ms();
+
+/// Milliseconds since the epoch on the wall clock
+int64_t wall_ms();
+
+#define DELIMITER_MAX_LEN 32
+
+/// Incremental search for a fixed delimiter in a byte stream (Knuth-Morris-Pratt). The partial match is carried
+/// from one call to the next, so a delimiter split across reads is still found and every byte is only looked at
+/// once. Holds no heap memory so it is cheap to copy.
+class Delimiter_Matcher
+{
+  public:
+    Delimiter_Matcher(const char * delim = "");
+
+    /// Scan data until the end of the first delimiter - returns the number of bytes consumed (all of them if no
+    /// delimiter ended) and sets found if one did
+    uint32_t scan(const uint8_t * data, uint32_t size, bool * found);
+
+    /// Forget any partial match
+    void reset();
+
+  private:
+    char m_delim[DELIMITER_MAX_LEN];
+    uint8_t m_fail[DELIMITER_MAX_LEN];
+    uint8_t m_len;
+    uint8_t m_matched;
+};
+
 template<class T>
 void zero_buf(T * buf, uint32_t size)
 {
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "json.h"
+#include "config_strip.h"
+
+// Times the single pass config stripper (config_strip.h) against the erase based _strip_comments/_strip_empty_lines
+// Config_File used to run, on generated configs with the given numbers of loggers, and checks that the stripped
+// output still parses with "//" inside strings intact and no blank lines left - returns 1 if any check fails.
+// Radios don't have entries of their own (just the ip range), so it's the number of loggers that makes a config big.
+
+// The old strippers as they were - each comment or blank line is an erase that moves the rest of the file, and the
+// comment search starts over from the top every time
+static void old_strip_comments(std::string & str)
+{
+    size_t pos = str.find("//");
+    while (pos != std::string::npos)
+    {
+        size_t nlpos = str.find('\n', pos);
+        str.erase(pos, nlpos - pos);
+        pos = str.find("//");
+    }
+}
+
+static void old_strip_empty_lines(std::string & str)
+{
+    size_t pos = 0;
+    while (pos < str.size())
+    {
+        if (pos)
+            ++pos;
+
+        size_t nlpos = str.find('\n', pos);
+        if (str.find_first_not_of(' ', pos) == nlpos)
+        {
+            if (nlpos == std::string::npos)
+                str.erase(pos, nlpos);
+            else
+                str.erase(pos, nlpos - pos + 1);
+        }
+        else
+        {
+            pos = nlpos;
+        }
+    }
+}
+
+static const char * LOGGER_PARAMS[] = {"forward_power", "reverse_power", "vswr", "agc", "line_level"};
+
+// A commented config like Config.md's reference, with every other logger written with \r\n line endings and blank
+// lines holding tabs and carriage returns
+static std::string generate_config(uint32_t logger_count)
+{
+    std::string cfg;
+    cfg += "{\n";
+    cfg += "    // bool - If false all loggers are disabled - no csv files will be generated\n";
+    cfg += "    \"logging_enabled\": true,\n\n";
+    cfg += "    // int - for the subnet 192.168.102, which number in the last octet to scan FROM\n";
+    cfg += "    \"ip_lower_bound\": 1,\n";
+    cfg += "    \"ip_upper_bound\": 254, // up to 254 radios\n";
+    cfg += "    \t \n";
+    cfg += "    \"loggers\": {\n";
+    for (uint32_t l = 0; l < logger_count; ++l)
+    {
+        std::string nl = (l % 2) ? "\r\n" : "\n";
+        std::string name = "L" + std::to_string(l);
+        cfg += "        // object - logger " + name + nl;
+        cfg += "        \"" + name + "\": {" + nl;
+        cfg += "            // string - the folder where this logger should be saved" + nl;
+        cfg += "            \"dir_path\": \"//media/usb0//csvlogs/" + name + "\"," + nl;
+        cfg += "\t\r" + nl;
+        cfg += "            \"period\": " + std::to_string(l % 1000) + ", // ms" + nl;
+        for (size_t p = 0; p < sizeof(LOGGER_PARAMS) / sizeof(LOGGER_PARAMS[0]); ++p)
+        {
+            cfg += "            // object - property " + std::string(LOGGER_PARAMS[p]) + nl;
+            cfg += "            \"" + std::string(LOGGER_PARAMS[p]) + "\": {" + nl;
+            cfg += "                \"title\": \"" + std::string(LOGGER_PARAMS[p]) + " \\\"//\\\" " + name + "\"," + nl;
+            cfg += "                // float - no default" + nl;
+            cfg += "                \"change\": 0.5 // (no default)" + nl;
+            cfg += "            }" + std::string((p + 1 < sizeof(LOGGER_PARAMS) / sizeof(LOGGER_PARAMS[0])) ? "," : "") + nl;
+            cfg += "    " + nl;
+        }
+        cfg += "        }" + std::string((l + 1 < logger_count) ? "," : "") + nl;
+        cfg += nl;
+    }
+    cfg += "    }\n";
+    cfg += "}\n";
+    cfg += "// trailing comment with no line ending";
+    return cfg;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool has_blank_line(const std::string & str)
+{
+    size_t pos = 0;
+    while (pos < str.size())
+    {
+        size_t nlpos = str.find('\n', pos);
+        if (nlpos == std::string::npos)
+            nlpos = str.size();
+        if (str.find_first_not_of(" \t\r", pos) >= nlpos)
+            return true;
+        pos = nlpos + 1;
+    }
+    return false;
+}
+
+static bool check(bool cond, const char * what)
+{
+    if (!cond)
+        printf("  FAILED: %s\n", what);
+    return cond;
+}
+
+// Small hand written cases with the exact output expected
+static bool check_cases()
+{
+    struct Strip_Case
+    {
+        const char * name;
+        const char * in;
+        const char * out;
+    };
+    static const Strip_Case CASES[] = {
+        {"comment after a value", "{\"a\": 1 // one\n}", "{\"a\": 1 \n}"},
+        {"// inside a string", "{\"url\": \"http://host//path\"}\n", "{\"url\": \"http://host//path\"}\n"},
+        {"escaped quote before //", "{\"t\": \"a\\\"//b\" // c\n}", "{\"t\": \"a\\\"//b\" \n}"},
+        {"blank lines with tabs and \\r", "{\n \t\r\n\r\n\t\n\"a\": 1\r\n    \n}", "{\n\"a\": 1\r\n}"},
+        {"comment only lines", "// top\n{\n    // inner\n}\n// end", "{\n}\n"},
+        {"trailing blank line without ending", "{}\n \t", "{}\n"},
+    };
+
+    bool ok = true;
+    std::string out;
+    for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); ++i)
+    {
+        strip_config_comments(CASES[i].in, &out);
+        ok = check(out == CASES[i].out, CASES[i].name) && ok;
+    }
+    return ok;
+}
+
+// The stripped generated config must parse to the loggers that went in, with their "//" strings intact
+static bool check_generated(const std::string & stripped, uint32_t logger_count)
+{
+    bool ok = check(!has_blank_line(stripped), "stripped config has no blank lines");
+    nlohmann::json obj = nlohmann::json::parse(stripped, nullptr, false);
+    if (!check(!obj.is_discarded(), "stripped config parses"))
+        return false;
+
+    const nlohmann::json & loggers = obj["loggers"];
+    ok = check(loggers.size() == logger_count, "every logger is in the stripped config") && ok;
+    for (uint32_t l = 0; l < logger_count && ok; ++l)
+    {
+        std::string name = "L" + std::to_string(l);
+        auto fiter = loggers.find(name);
+        if (!check(fiter != loggers.end(), "logger is found by name"))
+            return false;
+        ok = check(fiter->value("dir_path", "") == "//media/usb0//csvlogs/" + name, "dir_path keeps its \"//\"") && ok;
+        ok = check((*fiter)["vswr"].value("title", "") == "vswr \"//\" " + name, "title keeps its escaped \"//\"") && ok;
+    }
+    return ok;
+}
+
+int main(int argc, char ** argv)
+{
+    std::vector<uint32_t> logger_counts;
+    uint32_t iterations = 3;
+    for (int i = 1; i < argc; ++i)
+    {
+        uint32_t cnt = atoi(argv[i]);
+        if (cnt == 0)
+        {
+            fprintf(stderr, "Usage: %s [logger_count...] (default 250 1000 2000)\n", argv[0]);
+            return 1;
+        }
+        logger_counts.push_back(cnt);
+    }
+    if (logger_counts.empty())
+        logger_counts = {250, 1000, 2000};
+
+    bool ok = check_cases();
+    printf("hand written cases: %s\n", ok ? "pass" : "fail");
+
+    for (size_t s = 0; s < logger_counts.size(); ++s)
+    {
+        uint32_t logger_count = logger_counts[s];
+        std::string cfg = generate_config(logger_count);
+
+        // Old path - the strippers worked in place, so every iteration needs a fresh copy
+        double old_ms = 0;
+        for (uint32_t it = 0; it < iterations; ++it)
+        {
+            std::string str = cfg;
+            auto start = std::chrono::steady_clock::now();
+            old_strip_comments(str);
+            old_strip_empty_lines(str);
+            old_ms += elapsed_ms(start);
+        }
+        old_ms /= iterations;
+
+        std::string stripped;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t it = 0; it < iterations; ++it)
+            strip_config_comments(cfg, &stripped);
+        double new_ms = elapsed_ms(start) / iterations;
+
+        printf("%u loggers (%.1f KB)\n", logger_count, cfg.size() / 1024.0);
+        printf("  erase based: %10.3f ms\n", old_ms);
+        printf("  single pass: %10.3f ms\n", new_ms);
+        printf("  speedup:     %10.1fx\n", old_ms / new_ms);
+        ok = check_generated(stripped, logger_count) && ok;
+    }
+
+    printf("%s\n", ok ? "all checks passed" : "some checks FAILED");
+    return ok ? 0 : 1;
+}
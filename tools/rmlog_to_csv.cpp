@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "binary_log.h"
+
+// Renders a binary radio log (see binary_log.h) as the csv the logger would have written
+
+static void print_usage(const char * prog)
+{
+    fprintf(stderr, "Usage: %s <log%s> [out.csv]\n", prog, BINARY_LOG_EXTENSION);
+    fprintf(stderr, "Writes to stdout if no output file is given\n");
+}
+
+static void write_line(const std::string & line, FILE * out)
+{
+    fwrite(line.data(), 1, line.size(), out);
+    fputc('\n', out);
+}
+
+static void write_header(const Binary_Log_Schema & schema, FILE * out)
+{
+    std::string first_row;
+    std::string second_row;
+    for (size_t i = 0; i < schema.radios.size(); ++i)
+        csv::append_radio_header(schema.columns, schema.radios[i].serial, schema.radios[i].freq_mhz, &first_row, &second_row);
+    write_line(csv::finish_header(&first_row, &second_row), out);
+}
+
+static void write_row(const Binary_Log_Reader & reader, std::string * row, FILE * out)
+{
+    const Binary_Log_Schema & schema = reader.schema();
+    const uint8_t * values = reader.values();
+
+    row->clear();
+    csv::append_time(reader.wall_time(), reader.elapsed_s(), row);
+    size_t prefix_size = row->size();
+
+    for (size_t i = 0; i < schema.radios.size(); ++i)
+    {
+        uint8_t column_count = 0;
+        const uint8_t * columns = schema.columns.for_serial(schema.radios[i].serial, &column_count);
+        for (uint8_t col = 0; col < column_count; ++col)
+        {
+            csv::append_value(columns[col], blog::read_value(columns[col], values), row);
+            values += blog::value_size(columns[col]);
+        }
+    }
+
+    // No columns means no row at all
+    if (row->size() != prefix_size)
+        write_line(*row, out);
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc < 2 || argc > 3 || strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    Binary_Log_Reader reader;
+    if (!reader.open(argv[1]))
+    {
+        fprintf(stderr, "%s\n", reader.error().c_str());
+        return 1;
+    }
+
+    FILE * out = stdout;
+    if (argc == 3)
+    {
+        out = fopen(argv[2], "w");
+        if (!out)
+        {
+            fprintf(stderr, "Could not open %s: %s\n", argv[2], strerror(errno));
+            return 1;
+        }
+    }
+
+    std::string row;
+    uint64_t records = 0;
+    int ret = 0;
+    bool done = false;
+    while (!done)
+    {
+        switch (reader.next())
+        {
+        case Binary_Log_Reader::Schema:
+            if (reader.schema().flags & BLOG_FLAG_HEADER)
+                write_header(reader.schema(), out);
+            break;
+        case Binary_Log_Reader::Record:
+            write_row(reader, &row, out);
+            ++records;
+            break;
+        case Binary_Log_Reader::End:
+            done = true;
+            break;
+        case Binary_Log_Reader::Error:
+            // Most likely the last record was cut short by a power loss - everything before it is still good
+            fprintf(stderr, "Stopped after %llu records - %s\n", (unsigned long long)records, reader.error().c_str());
+            ret = 1;
+            done = true;
+            break;
+        }
+    }
+
+    if (out != stdout)
+        fclose(out);
+    return ret;
+}
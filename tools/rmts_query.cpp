@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <map>
+#include <algorithm>
+#include <limits>
+
+#include "series_store.h"
+
+// Lists the series in a radio series file (see series_store.h), or prints one series' points over a time range as csv
+
+static void print_usage(const char * prog)
+{
+    fprintf(stderr, "Usage: %s <file%s>                                    list the series in the file\n", prog, SERIES_FILE_EXTENSION);
+    fprintf(stderr, "       %s <file%s> <serial> <param> [from_ms [to_ms]]  print a series as csv\n", prog, SERIES_FILE_EXTENSION);
+    fprintf(stderr, "Times are ms since the epoch - param is one of:");
+    for (uint8_t i = 0; i < LP_COUNT; ++i)
+        fprintf(stderr, " %s", LOG_PARAM_NAMES[i]);
+    fprintf(stderr, "\n");
+}
+
+static std::string format_ms(int64_t t_ms)
+{
+    char buf[64];
+    time_t secs = t_ms / 1000;
+    tm ltm;
+    localtime_r(&secs, &ltm);
+    size_t len = strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &ltm);
+    snprintf(buf + len, sizeof(buf) - len, ".%03d", int(t_ms % 1000));
+    return buf;
+}
+
+static int list_series(const Series_Reader & reader)
+{
+    struct Series_Summary
+    {
+        uint32_t chunks;
+        uint64_t points;
+        uint64_t bytes;
+        int64_t first_ms;
+        int64_t last_ms;
+    };
+
+    std::map<std::pair<std::string, uint8_t>, Series_Summary> summary;
+    const std::vector<Series_Chunk_Info> & chunks = reader.chunks();
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        auto key = std::make_pair(std::string(chunks[i].serial), chunks[i].param);
+        auto iter = summary.find(key);
+        if (iter == summary.end())
+        {
+            Series_Summary sum = {0, 0, 0, chunks[i].first_ms, chunks[i].last_ms};
+            iter = summary.insert(std::make_pair(key, sum)).first;
+        }
+        Series_Summary & sum = iter->second;
+        ++sum.chunks;
+        sum.points += chunks[i].count;
+        sum.bytes += chunks[i].size + SERIES_CHUNK_HEADER_SIZE;
+        sum.first_ms = std::min(sum.first_ms, chunks[i].first_ms);
+        sum.last_ms = std::max(sum.last_ms, chunks[i].last_ms);
+    }
+
+    printf("Serial,Param,Chunks,Points,Bytes,First,Last\n");
+    auto iter = summary.begin();
+    while (iter != summary.end())
+    {
+        const Series_Summary & sum = iter->second;
+        const char * param = iter->first.second < LP_COUNT ? LOG_PARAM_NAMES[iter->first.second] : "unknown";
+        printf("%s,%s,%u,%llu,%llu,%s,%s\n",
+               iter->first.first.c_str(),
+               param,
+               sum.chunks,
+               (unsigned long long)sum.points,
+               (unsigned long long)sum.bytes,
+               format_ms(sum.first_ms).c_str(),
+               format_ms(sum.last_ms).c_str());
+        ++iter;
+    }
+    return 0;
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc < 2 || argc == 3 || argc > 6 || strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    Series_Reader reader;
+    if (!reader.open(argv[1]))
+    {
+        fprintf(stderr, "%s\n", reader.error().c_str());
+        return 1;
+    }
+    if (reader.truncated())
+        fprintf(stderr, "The last chunk in %s is incomplete - skipping it\n", argv[1]);
+
+    if (argc == 2)
+        return list_series(reader);
+
+    uint8_t param = LP_COUNT;
+    for (uint8_t i = 0; i < LP_COUNT; ++i)
+    {
+        if (strcmp(argv[3], LOG_PARAM_NAMES[i]) == 0)
+            param = i;
+    }
+    if (param == LP_COUNT)
+    {
+        fprintf(stderr, "Unknown param %s\n", argv[3]);
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    int64_t from_ms = std::numeric_limits<int64_t>::min();
+    int64_t to_ms = std::numeric_limits<int64_t>::max();
+    if (argc > 4)
+        from_ms = strtoll(argv[4], nullptr, 10);
+    if (argc > 5)
+        to_ms = strtoll(argv[5], nullptr, 10);
+
+    std::vector<Series_Point> points;
+    if (!reader.query(argv[2], param, from_ms, to_ms, &points))
+    {
+        fprintf(stderr, "%s\n", reader.error().c_str());
+        return 1;
+    }
+
+    // Values are printed the same way as in the csv logs
+    printf("Time,Time (ms),%s\n", argv[3]);
+    std::string row;
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        row = format_ms(points[i].t_ms) + "," + std::to_string(points[i].t_ms);
+        csv::append_value(param, points[i].value, &row);
+        printf("%s\n", row.c_str());
+    }
+    return 0;
+}
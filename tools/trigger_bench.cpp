@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "trigger_eval.h"
+
+// Times the batch trigger kernels (trigger_eval.h) against the per radio checks they replaced, over radios x loggers.
+// Build it with the same flags as the monitor (trigger_eval.cpp gets -fno-trapping-math from CMakeLists.txt) so the
+// kernels are vectorized the same way.
+
+static const float BENCH_EPS = 0.001f;
+
+// A condition as the per radio path saw it - an enabled flag per threshold
+struct Old_Float_Option
+{
+    bool change_on, percent_on, less_on, greater_on;
+    float change, percent, less_than, greater_than;
+};
+
+struct Old_Status_Option
+{
+    bool change_on, equal_on;
+    int32_t equal;
+};
+
+// Row wise radio like CM300_Radio - one struct per radio with every value in it
+struct Old_Radio
+{
+    bool is_tx;
+    int32_t status;
+    float fwd, vswr, agc, line_level;
+};
+
+struct Bench_Logger
+{
+    Old_Float_Option fopt[2];
+    Old_Status_Option sopt;
+    Float_Trigger ftrig[2];
+    Status_Trigger strig;
+};
+
+static uint8_t old_check_float(const Old_Float_Option & opt, float cur_val, float prev_val)
+{
+    double change = fabs(cur_val - prev_val);
+    double percent_change = change;
+    if (!(change < BENCH_EPS))
+        percent_change = change / fabs(cur_val);
+    percent_change *= 100.0;
+
+    bool cond_change = (opt.change_on && (change > opt.change));
+    bool cond_percent_change = (opt.percent_on && (percent_change > opt.percent));
+    bool cond_less_than = (opt.less_on && (cur_val < opt.less_than));
+    bool cond_greater_than = (opt.greater_on && (cur_val > opt.greater_than));
+    bool cond_less_greater = cond_less_than || cond_greater_than;
+    if (opt.less_on && opt.greater_on && (opt.less_than > opt.greater_than))
+        cond_less_greater = cond_less_than && cond_greater_than;
+    return ((cond_change || cond_percent_change) ? TRIGGER_CHANGE : 0) | (cond_less_greater ? TRIGGER_LEVEL : 0);
+}
+
+static uint8_t old_check_status(const Old_Status_Option & opt, int32_t cur, int32_t prev)
+{
+    bool cond_change = (opt.change_on && (cur != prev));
+    bool cond_equal = (opt.equal_on && ((opt.equal & cur) == cur));
+    return (cond_change ? TRIGGER_CHANGE : 0) | (cond_equal ? TRIGGER_LEVEL : 0);
+}
+
+static Float_Trigger compile_float(const Old_Float_Option & opt)
+{
+    Float_Trigger ft;
+    if (opt.change_on)
+        ft.change = opt.change;
+    if (opt.percent_on)
+        ft.percent_change = opt.percent;
+    if (opt.less_on)
+        ft.less_than = opt.less_than;
+    if (opt.greater_on)
+        ft.greater_than = opt.greater_than;
+    ft.inside_band = (opt.less_on && opt.greater_on && (opt.less_than > opt.greater_than));
+    return ft;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char ** argv)
+{
+    uint32_t radio_count = (argc > 1) ? atoi(argv[1]) : 256;
+    uint32_t logger_count = (argc > 2) ? atoi(argv[2]) : 8;
+    uint32_t iterations = (argc > 3) ? atoi(argv[3]) : 2000;
+    if (radio_count == 0 || logger_count == 0 || iterations == 0)
+    {
+        fprintf(stderr, "Usage: %s [radios=256] [loggers=8] [iterations=2000]\n", argv[0]);
+        return 1;
+    }
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> value(1.0f, 100.0f);
+    std::uniform_int_distribution<int32_t> status(1, 4);
+    std::uniform_int_distribution<int32_t> coin(0, 1);
+
+    std::vector<Bench_Logger> loggers(logger_count);
+    for (uint32_t l = 0; l < logger_count; ++l)
+    {
+        Bench_Logger & bl = loggers[l];
+        for (int p = 0; p < 2; ++p)
+        {
+            Old_Float_Option & o = bl.fopt[p];
+            o.change_on = coin(rng);
+            o.percent_on = coin(rng);
+            o.less_on = coin(rng);
+            o.greater_on = coin(rng);
+            o.change = value(rng) / 4.0f;
+            o.percent = value(rng) / 2.0f;
+            o.less_than = value(rng);
+            o.greater_than = value(rng);
+            bl.ftrig[p] = compile_float(o);
+        }
+        bl.sopt.change_on = coin(rng);
+        bl.sopt.equal_on = coin(rng);
+        bl.sopt.equal = status(rng);
+        bl.strig.change = bl.sopt.change_on;
+        bl.strig.equal = bl.sopt.equal_on;
+        bl.strig.equal_mask = uint8_t(bl.sopt.equal);
+    }
+
+    // Current and logged values - row wise for the old path, column wise for the kernels
+    std::vector<Old_Radio> cur(radio_count), prev(radio_count);
+    std::vector<uint8_t> is_tx(radio_count), cur_status(radio_count), prev_status(radio_count);
+    std::vector<float> cur_fwd(radio_count), prev_fwd(radio_count), cur_vswr(radio_count), prev_vswr(radio_count);
+    std::vector<float> cur_agc(radio_count), prev_agc(radio_count), cur_ll(radio_count), prev_ll(radio_count);
+    for (uint32_t i = 0; i < radio_count; ++i)
+    {
+        Old_Radio r = {(i % 2) == 0, status(rng), value(rng), value(rng), value(rng), value(rng)};
+        Old_Radio p = {r.is_tx, status(rng), value(rng), value(rng), value(rng), value(rng)};
+        cur[i] = r;
+        prev[i] = p;
+        is_tx[i] = r.is_tx;
+        cur_status[i] = uint8_t(r.status);
+        prev_status[i] = uint8_t(p.status);
+        cur_fwd[i] = r.fwd;
+        prev_fwd[i] = p.fwd;
+        cur_vswr[i] = r.vswr;
+        prev_vswr[i] = p.vswr;
+        cur_agc[i] = r.agc;
+        prev_agc[i] = p.agc;
+        cur_ll[i] = r.line_level;
+        prev_ll[i] = p.line_level;
+    }
+
+    // Per radio - each radio walks its type's columns with the enabled checks inline
+    std::vector<uint8_t> old_triggers(radio_count * logger_count);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t it = 0; it < iterations; ++it)
+    {
+        for (uint32_t l = 0; l < logger_count; ++l)
+        {
+            const Bench_Logger & bl = loggers[l];
+            uint8_t * triggers = &old_triggers[l * radio_count];
+            for (uint32_t i = 0; i < radio_count; ++i)
+            {
+                const Old_Radio & c = cur[i];
+                const Old_Radio & p = prev[i];
+                uint8_t t = old_check_status(bl.sopt, c.status, p.status);
+                if (c.is_tx)
+                    t |= old_check_float(bl.fopt[0], c.fwd, p.fwd) | old_check_float(bl.fopt[1], c.vswr, p.vswr);
+                else
+                    t |= old_check_float(bl.fopt[0], c.agc, p.agc) | old_check_float(bl.fopt[1], c.line_level, p.line_level);
+                triggers[i] = t;
+            }
+        }
+    }
+    double old_ms = elapsed_ms(start);
+
+    // Batch - one kernel pass per column over every radio
+    std::vector<uint8_t> new_triggers(radio_count * logger_count);
+    start = std::chrono::steady_clock::now();
+    for (uint32_t it = 0; it < iterations; ++it)
+    {
+        for (uint32_t l = 0; l < logger_count; ++l)
+        {
+            const Bench_Logger & bl = loggers[l];
+            uint8_t * triggers = &new_triggers[l * radio_count];
+            for (uint32_t i = 0; i < radio_count; ++i)
+                triggers[i] = 0;
+            eval_status_trigger(bl.strig, cur_status.data(), prev_status.data(), is_tx.data(), 1, radio_count, triggers);
+            eval_status_trigger(bl.strig, cur_status.data(), prev_status.data(), is_tx.data(), 0, radio_count, triggers);
+            eval_float_trigger(bl.ftrig[0], cur_fwd.data(), prev_fwd.data(), is_tx.data(), 1, BENCH_EPS, radio_count, triggers);
+            eval_float_trigger(bl.ftrig[1], cur_vswr.data(), prev_vswr.data(), is_tx.data(), 1, BENCH_EPS, radio_count, triggers);
+            eval_float_trigger(bl.ftrig[0], cur_agc.data(), prev_agc.data(), is_tx.data(), 0, BENCH_EPS, radio_count, triggers);
+            eval_float_trigger(bl.ftrig[1], cur_ll.data(), prev_ll.data(), is_tx.data(), 0, BENCH_EPS, radio_count, triggers);
+        }
+    }
+    double new_ms = elapsed_ms(start);
+
+    uint32_t differ = 0;
+    for (size_t i = 0; i < old_triggers.size(); ++i)
+        differ += (old_triggers[i] != new_triggers[i]);
+
+    double evals = double(radio_count) * logger_count * iterations;
+    printf("%u radios x %u loggers x %u iterations\n", radio_count, logger_count, iterations);
+    printf("  per radio: %9.2f ms  (%6.2f ns per radio per logger)\n", old_ms, old_ms * 1e6 / evals);
+    printf("  batch:     %9.2f ms  (%6.2f ns per radio per logger)\n", new_ms, new_ms * 1e6 / evals);
+    printf("  speedup:   %9.2fx\n", old_ms / new_ms);
+    if (differ != 0)
+    {
+        printf("  results differ for %u of %zu radio/logger pairs\n", differ, old_triggers.size());
+        return 1;
+    }
+    printf("  results match\n");
+    return 0;
+}